@@ -0,0 +1,264 @@
+#include "batch.hh"
+#include "host_profile.hh"
+#include "parser.hh"
+#include "pool.hh"
+#include "simulator.hh"
+#include "util.hh"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void CollectInput(const std::string &input, std::vector<std::string> &paths) {
+  if (!input.empty() && input[0] == '@') {
+    std::ifstream fin(input.substr(1));
+    std::string line;
+    while (std::getline(fin, line)) {
+      if (!line.empty())
+        CollectInput(line, paths);
+    }
+    return;
+  }
+  std::error_code ec;
+  if (std::filesystem::is_directory(input, ec)) {
+    std::vector<std::string> dir_paths;
+    for (const auto &entry : std::filesystem::directory_iterator(input, ec)) {
+      const auto extension = entry.path().extension();
+      if (entry.is_regular_file() &&
+          (extension == ".S" || extension == ".tbin"))
+        dir_paths.push_back(entry.path().string());
+    }
+    std::sort(dir_paths.begin(), dir_paths.end());
+    paths.insert(paths.end(), dir_paths.begin(), dir_paths.end());
+    return;
+  }
+  paths.push_back(input);
+}
+
+// Timing of the first kMaxTimedInstructions instructions in program order.
+// They write back out of order, so the early ones wait here until every
+// older one has.
+class TimingCollector {
+public:
+  // retired since the start, or since the checkpoint resumed from
+  size_t num_instructions_{0};
+  std::ostringstream timing_;
+
+  // After sim resumed from a checkpoint: start at its oldest instruction,
+  // and pass over the younger ones it had already retired.
+  void Resume(const TomasuloSimulator &sim) {
+    next_seq_ = end_seq_ = sim.first_seq_;
+    end_seq_ += kMaxTimedInstructions;
+    for (size_t seq = sim.first_seq_; seq < std::min(sim.fetch_, end_seq_);
+         ++seq) {
+      const Instruction &inst = sim.At(seq);
+      if ((sim.RobMode() ? inst.commit_time_ : inst.write_time_) != -1)
+        pending_[seq] = std::nullopt;
+    }
+    Drain();
+  }
+  void Add(size_t seq, const Instruction &inst) {
+    ++num_instructions_;
+    // past the cap only the count goes on, so the row stays bounded
+    if (seq >= end_seq_)
+      return;
+    pending_[seq] = std::array<Cycle, 4>{inst.issue_time_,
+                                         inst.exec_begin_time_,
+                                         inst.exec_end_time_, inst.write_time_};
+    Drain();
+  }
+
+private:
+  void Drain() {
+    for (auto it = pending_.begin();
+         it != pending_.end() && it->first == next_seq_;
+         it = pending_.erase(it)) {
+      ++next_seq_;
+      if (!it->second) // retired before the checkpoint
+        continue;
+      if (!first_)
+        timing_ << ';';
+      first_ = false;
+      const auto &times = *it->second;
+      timing_ << times[0] << ':' << times[1] << ':' << times[2] << ':'
+              << times[3];
+    }
+  }
+
+  size_t next_seq_{0}; // oldest not yet written out
+  size_t end_seq_{kMaxTimedInstructions}; // first one not timed
+  bool first_{true};
+  std::map<size_t, std::optional<std::array<Cycle, 4>>> pending_;
+};
+
+// A column of the batch and sweep rows
+class BatchColumn {
+public:
+  const char *name_;
+  std::string (*value_)(const BatchResult &result);
+  bool on_error_; // filled in for a failed run too, the rest is left empty
+  bool in_sweep_;
+};
+
+std::string ToText(size_t value) { return std::to_string(value); }
+
+const BatchColumn kBatchColumns[] = {
+    {"trace", [](const BatchResult &r) { return r.path_; }, true, true},
+    {"status",
+     [](const BatchResult &r) { return std::string(r.ok_ ? "ok" : "error"); },
+     true, true},
+    {"cycles", [](const BatchResult &r) { return ToText(r.cycles_); }, false,
+     true},
+    {"instructions",
+     [](const BatchResult &r) { return ToText(r.num_instructions_); }, false,
+     true},
+    {"raw_stalls", [](const BatchResult &r) { return ToText(r.raw_stalls_); },
+     false, true},
+    {"war_stalls", [](const BatchResult &r) { return ToText(r.war_stalls_); },
+     false, true},
+    {"branches", [](const BatchResult &r) { return ToText(r.branches_); },
+     false, true},
+    {"mispredicts",
+     [](const BatchResult &r) { return ToText(r.mispredicts_); }, false, true},
+    {"cycle_stack", [](const BatchResult &r) { return r.cycle_stack_; }, false,
+     true},
+    {"memory", [](const BatchResult &r) { return r.memory_; }, false, true},
+    {"timing", [](const BatchResult &r) { return r.timing_; }, false, false},
+    {"host_profile", [](const BatchResult &r) { return r.host_profile_; },
+     false, false},
+    {"error", [](const BatchResult &r) { return r.error_; }, true, true},
+};
+
+} // namespace
+
+BatchResult SimulateTrace(const std::string &path,
+                          const SimulationOptions &options,
+                          bool collect_timing) {
+  BatchResult result;
+  result.path_ = path;
+  auto reader = OpenTrace(path, result.error_);
+  if (reader == nullptr)
+    return result;
+  // streamed: only the instructions in flight are kept
+  TomasuloSimulator sim(reader, options.config_);
+  options.Apply(sim);
+  if (!options.Resume(sim, result.error_) ||
+      !options.OpenPipelineTrace(sim, path, result.error_))
+    return result;
+  sim.record_history_ = false;
+  sim.retain_instructions_ = false;
+  TimingCollector timing;
+  timing.Resume(sim);
+  if (collect_timing) {
+    sim.retire_sink_ = [&timing](size_t seq, const Instruction &inst) {
+      timing.Add(seq, inst);
+    };
+  } else {
+    sim.retire_sink_ = [&timing](size_t, const Instruction &) {
+      ++timing.num_instructions_;
+    };
+  }
+  sim.RunToEnd();
+  if (!options.ClosePipelineTrace(sim, result.error_))
+    return result;
+  if (!reader->error_.empty() || !sim.error_.empty()) {
+    result.error_ = reader->error_.empty() ? sim.error_ : reader->error_;
+    return result;
+  }
+  {
+    HostScope print(sim.host_profile_, HostPhase::PRINT);
+    if (!options.Dump(sim, path, result.error_))
+      return result;
+  }
+  result.ok_ = true;
+  result.cycles_ = sim.clocks_;
+  result.num_instructions_ = timing.num_instructions_;
+  result.raw_stalls_ = sim.raw_stalls_;
+  result.war_stalls_ = sim.war_stalls_;
+  result.branches_ = sim.control_.branches_;
+  result.mispredicts_ = sim.control_.mispredicts_;
+  result.cycle_stack_ = sim.account_.RunStackString();
+  result.memory_ = sim.memory_timing_.StatsString();
+  result.timing_ = timing.timing_.str();
+  result.host_profile_ = sim.host_profile_.String();
+  return result;
+}
+
+std::vector<std::string>
+CollectTraceFiles(const std::vector<std::string> &inputs) {
+  std::vector<std::string> paths;
+  for (const auto &input : inputs) {
+    CollectInput(input, paths);
+  }
+  return paths;
+}
+
+size_t RunBatch(const std::vector<std::string> &paths, size_t num_threads,
+                const SimulationOptions &options, std::ostream &os,
+                std::ostream &errors) {
+  // finished rows wait here for the earlier ones, then go out and are freed
+  std::vector<std::string> rows(paths.size());
+  std::vector<char> done(paths.size(), 0);
+  size_t next_row = 0;
+  size_t num_failed = 0;
+  std::mutex mutex;
+  ParallelFor(paths.size(), num_threads, [&](size_t i) {
+    const BatchResult result = SimulateTrace(paths[i], options, true);
+    std::ostringstream oss;
+    result.Print(oss, false);
+    std::lock_guard<std::mutex> lock(mutex);
+    rows[i] = oss.str();
+    done[i] = 1;
+    if (!result.ok_) {
+      errors << result.error_ << '\n';
+      ++num_failed;
+    }
+    for (; next_row < rows.size() && done[next_row]; ++next_row) {
+      os << rows[next_row] << '\n';
+      std::string().swap(rows[next_row]);
+    }
+    os.flush();
+  });
+  return num_failed;
+}
+
+void BatchResult::Print(std::ostream &os, bool sweep) const {
+  const char *sep = "";
+  for (const auto &column : kBatchColumns) {
+    if (sweep && !column.in_sweep_)
+      continue;
+    os << sep;
+    if (ok_ || column.on_error_)
+      os << column.value_(*this);
+    sep = "\t";
+  }
+}
+
+void BatchResult::HelpPrintHeader(std::ostream &os, bool sweep) {
+  const char *sep = "";
+  for (const auto &column : kBatchColumns) {
+    if (sweep && !column.in_sweep_)
+      continue;
+    os << sep << column.name_;
+    sep = "\t";
+  }
+}
+
+void HelpPrintBatchHeader(std::ostream &os) {
+  // timing: issue:exec_begin:exec_end:write of every timed instruction,
+  // ';'-joined
+  // host_profile: phase=milliseconds:entries of the simulator itself, -H
+  BatchResult::HelpPrintHeader(os, false);
+  os << '\n';
+}
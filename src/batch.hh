@@ -0,0 +1,61 @@
+#pragma once
+
+#include "options.hh"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// instructions of a batch run whose timing is reported, so a row stays
+// bounded however long the run
+constexpr size_t kMaxTimedInstructions = 1 << 16;
+
+// Result of simulating one trace in batch mode
+class BatchResult {
+public:
+  std::string path_;
+  bool ok_{false};
+  std::string error_;
+  size_t cycles_{0};
+  size_t num_instructions_{0};
+  size_t raw_stalls_{0};
+  size_t war_stalls_{0};
+  size_t branches_{0};
+  size_t mispredicts_{0};
+  // CPI stack of the run, see CycleAccount::RunStackString()
+  std::string cycle_stack_;
+  // see MemoryTiming::StatsString()
+  std::string memory_;
+  // issue:exec_begin:exec_end:write of the first kMaxTimedInstructions
+  // instructions, ';'-joined
+  std::string timing_;
+  // see HostProfile::String(), empty unless profiled
+  std::string host_profile_;
+
+  // The columns of a row, tab-separated, those of a failed run but trace,
+  // status and error left empty. Sweep rows have no timing or host_profile.
+  void Print(std::ostream &os, bool sweep) const;
+  static void HelpPrintHeader(std::ostream &os, bool sweep);
+};
+
+// Simulate the trace at path to completion without the interactive loop,
+// streaming it under options. Fills timing_ only if collect_timing.
+BatchResult SimulateTrace(const std::string &path,
+                          const SimulationOptions &options,
+                          bool collect_timing);
+
+// Expand the batch inputs into a list of trace files.
+// An input is a trace file, a directory (all *.S files in it, sorted), or
+// @listfile (one input per line).
+std::vector<std::string>
+CollectTraceFiles(const std::vector<std::string> &inputs);
+
+// Simulate every trace to completion on a pool of num_threads workers and
+// write one row per trace to os, in the order of paths, each as soon as it
+// and the ones before it are done; the error of a failed one also goes to
+// errors. Return the number of failed simulations.
+size_t RunBatch(const std::vector<std::string> &paths, size_t num_threads,
+                const SimulationOptions &options, std::ostream &os,
+                std::ostream &errors);
+
+void HelpPrintBatchHeader(std::ostream &os);
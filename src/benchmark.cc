@@ -0,0 +1,147 @@
+// Throughput of the simulator on synthetic workloads.
+// Every workload is generated in memory, then simulated the way batch mode
+// does, and the host time of the simulation alone is measured. With the
+// default machine the cycle counts must match the golden ones recorded
+// below, so a change to the engine that alters timing is caught along with
+// one that slows it down.
+#include "config.hh"
+#include "options.hh"
+#include "parser.hh"
+#include "simulator.hh"
+#include "workload.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+class BenchmarkCase {
+public:
+  const char *name_;
+  const char *spec_; // WorkloadSpec
+  size_t golden_cycles_; // on the default MachineConfig
+};
+
+const BenchmarkCase kCases[] = {
+    {"mix-1k", "length=1000,seed=1", 4126},
+    {"mix-10k", "length=10000,seed=2", 36387},
+    {"mix-100k", "length=100000,seed=3", 351905},
+    {"mix-1m", "length=1000000,seed=4", 3538736},
+    {"fp-chain-100k", "length=100000,seed=5,load=0,store=0,dep_distance=1",
+     862809},
+    {"fp-free-100k", "length=100000,seed=6,load=0,store=0,dep_distance=0",
+     394609},
+    {"memory-100k",
+     "length=100000,seed=7,load=40,store=30,dep_distance=8,footprint=1048576",
+     232653},
+    {"int-100k", "length=100000,seed=8,int=60,dep_distance=16", 185476},
+};
+
+// anything longer is left out by -q
+constexpr int kQuickLength = 100000;
+
+void PrintUsage() {
+  std::cerr << "Usage: ./TomasuloBenchmark [-q] [-r repeats] [options]\n"
+            << "  -q       quick, workloads of up to " << kQuickLength
+            << " instructions\n"
+            << "  -r n     simulate every workload n times, report the "
+               "fastest\n"
+            << "  options  as for the simulator, e.g. -C or -S; golden "
+               "cycle counts are\n"
+            << "           only checked on the default machine\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  SimulationOptions options;
+  bool quick = false;
+  int repeats = 1;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::string error;
+    if (options.Parse(argc, argv, i, error)) {
+      if (!error.empty()) {
+        std::cerr << error << '\n';
+        return -1;
+      }
+    } else if (arg == "-q") {
+      quick = true;
+    } else if (arg == "-r" && i + 1 < argc) {
+      repeats = std::max(1, std::atoi(argv[++i]));
+    } else {
+      PrintUsage();
+      return -1;
+    }
+  }
+  std::ostringstream config_text, default_text;
+  options.config_.Print(config_text);
+  MachineConfig().Print(default_text);
+  const bool check_golden = config_text.str() == default_text.str();
+
+  std::cout << "workload\tinstructions\tcycles\tseconds\tcycles_per_second\t"
+               "instructions_per_second\tgolden\n";
+  int num_mismatches = 0;
+  for (const auto &test : kCases) {
+    WorkloadSpec spec;
+    std::string error;
+    if (!spec.Parse(test.spec_, error)) {
+      std::cerr << test.name_ << ": " << error << '\n';
+      return -1;
+    }
+    if (quick && spec.length_ > kQuickLength)
+      continue;
+    std::ostringstream text;
+    if (!GenerateWorkload(spec, text, error)) {
+      std::cerr << test.name_ << ": " << error << '\n';
+      return -1;
+    }
+    const std::string trace = text.str();
+    double best_seconds = 0;
+    size_t cycles = 0;
+    for (int repeat = 0; repeat < repeats; ++repeat) {
+      auto reader = TraceReader::FromString(trace, test.name_);
+      TomasuloSimulator sim(reader, options.config_);
+      options.Apply(sim);
+      sim.record_history_ = false;
+      sim.retain_instructions_ = false;
+      const auto begin = std::chrono::steady_clock::now();
+      sim.RunToEnd();
+      const std::chrono::duration<double> seconds =
+          std::chrono::steady_clock::now() - begin;
+      if (!reader->error_.empty() || !sim.error_.empty()) {
+        std::cerr << (reader->error_.empty() ? sim.error_ : reader->error_)
+                  << '\n';
+        return -1;
+      }
+      cycles = sim.clocks_;
+      if (repeat == 0 || seconds.count() < best_seconds)
+        best_seconds = seconds.count();
+    }
+    std::string golden = "-";
+    if (check_golden) {
+      golden = cycles == test.golden_cycles_
+                   ? "ok"
+                   : "MISMATCH, expected " +
+                         std::to_string(test.golden_cycles_);
+      num_mismatches += cycles != test.golden_cycles_;
+    }
+    const double seconds = std::max(best_seconds, 1e-9);
+    std::cout << test.name_ << '\t' << spec.length_ << '\t' << cycles << '\t'
+              << std::fixed << std::setprecision(4) << seconds << '\t'
+              << std::setprecision(0) << cycles / seconds << '\t'
+              << spec.length_ / seconds << '\t' << golden << '\n'
+              << std::defaultfloat << std::setprecision(6);
+  }
+  if (num_mismatches != 0) {
+    std::cerr << num_mismatches << " workloads ran a different number of "
+              << "cycles than recorded\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include "binary_trace.hh"
+#include "memory.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+
+bool IsBinaryTrace(const MappedFile &file) {
+  return file.size_ >= sizeof(kBinaryTraceMagic) &&
+         std::memcmp(file.data_, kBinaryTraceMagic,
+                     sizeof(kBinaryTraceMagic)) == 0;
+}
+
+std::shared_ptr<BinaryTraceReader>
+BinaryTraceReader::Open(std::shared_ptr<const MappedFile> file,
+                        const std::string &name, std::string &error) {
+  BinaryTraceHeader header;
+  if (!IsBinaryTrace(*file)) {
+    error = name + ": not a binary trace";
+    return nullptr;
+  }
+  if (file->size_ < sizeof(header)) {
+    error = name + ": truncated binary trace";
+    return nullptr;
+  }
+  std::memcpy(&header, file->data_, sizeof(header));
+  const uint64_t body = file->size_ - sizeof(header);
+  if (header.num_records_ > body / sizeof(BinaryTraceRecord) ||
+      header.strings_size_ !=
+          body - header.num_records_ * sizeof(BinaryTraceRecord)) {
+    error = name + ": truncated binary trace";
+    return nullptr;
+  }
+  auto reader = std::make_shared<BinaryTraceReader>();
+  reader->name_ = name;
+  // mmap returns page-aligned memory and the header is 8-byte aligned
+  reader->records_ = reinterpret_cast<const BinaryTraceRecord *>(
+      file->data_ + sizeof(header));
+  reader->strings_ = reinterpret_cast<const char *>(
+      reader->records_ + header.num_records_);
+  reader->num_records_ = header.num_records_;
+  reader->strings_size_ = header.strings_size_;
+  reader->file_ = std::move(file);
+  return reader;
+}
+
+// Whether the fields of an instruction fit its opcode
+static bool IsValidRecord(const BinaryTraceRecord &record) {
+  auto is_reg = [](RegId reg) { return reg < kNumRegisters; };
+  switch (static_cast<InstOp>(record.instop_)) {
+  case InstOp::LOAD:
+  case InstOp::STORE:
+  case InstOp::BEQ:
+  case InstOp::BNE:
+    return record.rd_ == kNoReg && is_reg(record.rs_) && is_reg(record.rt_);
+  case InstOp::ADDD:
+  case InstOp::SUBD:
+  case InstOp::MULD:
+  case InstOp::DIVD:
+    return is_reg(record.rd_) && is_reg(record.rs_) && is_reg(record.rt_);
+  case InstOp::DADDI:
+    return is_reg(record.rd_) && is_reg(record.rs_) && record.rt_ == kNoReg;
+  case InstOp::NONE:
+    break;
+  }
+  return false;
+}
+
+bool BinaryTraceReader::Decode(size_t pc, Instruction &inst) {
+  if (pc >= num_records_ || !error_.empty())
+    return false;
+  const BinaryTraceRecord &record = records_[pc];
+  // the file may come from anywhere, check what the simulator relies on
+  if (record.instop_ >= static_cast<uint8_t>(InstOp::NONE) ||
+      !IsValidRecord(record) || record.text_offset_ > strings_size_ ||
+      record.text_size_ > strings_size_ - record.text_offset_) {
+    error_ = name_ + ": record " + std::to_string(pc + 1) + " is invalid";
+    return false;
+  }
+  inst = Instruction(static_cast<InstOp>(record.instop_),
+                     std::string_view(strings_ + record.text_offset_,
+                                      record.text_size_),
+                     record.rd_, record.rs_, record.rt_, record.imm_);
+  inst.pc_ = pc;
+  return true;
+}
+
+bool WriteBinaryTrace(InstructionSource &source, const std::string &path,
+                      std::string &error) {
+  std::ofstream fout(path, std::ios::binary);
+  if (!fout) {
+    error = "Cannot open " + path;
+    return false;
+  }
+  BinaryTraceHeader header;
+  std::memcpy(header.magic_, kBinaryTraceMagic, sizeof(kBinaryTraceMagic));
+  header.num_records_ = 0;
+  // records are written as they are decoded, the text waits for the end
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  std::string strings;
+  Instruction inst;
+  for (size_t pc = 0; source.Decode(pc, inst); ++pc) {
+    if (strings.size() + inst.text_.size() > UINT32_MAX) {
+      error = path + ": instruction text exceeds 4 GiB";
+      return false;
+    }
+    BinaryTraceRecord record;
+    record.instop_ = static_cast<uint8_t>(inst.instop_);
+    record.rd_ = inst.rd_;
+    record.rs_ = inst.rs_;
+    record.rt_ = inst.rt_;
+    record.imm_ = inst.imm_;
+    record.text_offset_ = static_cast<uint32_t>(strings.size());
+    record.text_size_ = static_cast<uint32_t>(inst.text_.size());
+    strings += inst.text_;
+    fout.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    ++header.num_records_;
+  }
+  if (!source.error_.empty()) {
+    error = source.error_;
+    return false;
+  }
+  fout.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+  header.strings_size_ = strings.size();
+  fout.seekp(0);
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!fout) {
+    error = "Cannot write " + path;
+    return false;
+  }
+  return true;
+}
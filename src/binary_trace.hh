@@ -0,0 +1,58 @@
+#pragma once
+
+#include "memory.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Pre-decoded trace, for traces simulated many times over.
+// A header, then one fixed-width record per instruction, then a string table
+// with the text of every instruction. Fields are in host byte order; the
+// file is mapped and read in place, so loading costs nothing up front.
+constexpr char kBinaryTraceMagic[8] = {'T', 'O', 'M', 'A', 'T', 'R', 'C', '1'};
+
+class BinaryTraceHeader {
+public:
+  char magic_[8];
+  uint64_t num_records_;
+  uint64_t strings_size_; // bytes, the table follows the records
+};
+
+class BinaryTraceRecord {
+public:
+  uint8_t instop_;
+  RegId rd_;
+  RegId rs_;
+  RegId rt_;
+  int32_t imm_;
+  uint32_t text_offset_; // into the string table
+  uint32_t text_size_;
+};
+static_assert(sizeof(BinaryTraceRecord) == 16, "records are fixed-width");
+
+// True if file starts with kBinaryTraceMagic.
+bool IsBinaryTrace(const MappedFile &file);
+
+class BinaryTraceReader : public InstructionSource {
+public:
+  // Return nullptr and fill error if file is not a valid binary trace.
+  static std::shared_ptr<BinaryTraceReader>
+  Open(std::shared_ptr<const MappedFile> file, const std::string &name,
+       std::string &error);
+  bool Decode(size_t pc, Instruction &inst) override;
+
+private:
+  std::string name_;
+  std::shared_ptr<const MappedFile> file_;
+  const BinaryTraceRecord *records_{nullptr};
+  const char *strings_{nullptr};
+  uint64_t num_records_{0};
+  uint64_t strings_size_{0};
+};
+
+// Decode every instruction of source into a binary trace at path.
+// Return false and fill error on a malformed instruction or a write failure.
+bool WriteBinaryTrace(InstructionSource &source, const std::string &path,
+                      std::string &error);
@@ -0,0 +1,71 @@
+#include "cache.hh"
+#include "config.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+CacheLevel::CacheLevel(size_t num_sets, size_t num_ways)
+    : num_sets_(num_sets), num_ways_(num_ways),
+      lines_(num_sets * num_ways, kNoLine), last_use_(num_sets * num_ways, 0) {}
+
+bool CacheLevel::Access(uint64_t line, uint64_t now) {
+  const size_t begin = line % num_sets_ * num_ways_;
+  size_t victim = begin;
+  for (size_t way = begin; way < begin + num_ways_; ++way) {
+    if (lines_[way] == line) {
+      last_use_[way] = now;
+      ++hits_;
+      return true;
+    }
+    if (last_use_[way] < last_use_[victim])
+      victim = way;
+  }
+  // invalid ways were never used, so they go first
+  lines_[victim] = line;
+  last_use_[victim] = now;
+  ++misses_;
+  return false;
+}
+
+MemoryTiming::MemoryTiming(const MachineConfig &config)
+    : l1_(config.l1_sets_, config.l1_ways_),
+      l2_(config.l1_sets_ == 0 ? 0 : config.l2_sets_, config.l2_ways_),
+      line_bytes_(config.line_bytes_) {}
+
+uint64_t MemoryTiming::Line(uint64_t address, bool symbolic) const {
+  return symbolic ? address : address / line_bytes_;
+}
+
+int MemoryTiming::Load(uint64_t address, bool symbolic,
+                       const MachineConfig &config) {
+  const uint64_t line = Line(address, symbolic);
+  ++accesses_;
+  int latency = config.l1_latency_;
+  if (l1_.Access(line, accesses_))
+    return latency;
+  if (l2_.Enabled()) {
+    latency += config.l2_latency_;
+    if (l2_.Access(line, accesses_))
+      return latency;
+  }
+  return latency + config.memory_latency_;
+}
+
+void MemoryTiming::Store(uint64_t address, bool symbolic) {
+  const uint64_t line = Line(address, symbolic);
+  ++accesses_;
+  if (!l1_.Access(line, accesses_) && l2_.Enabled())
+    l2_.Access(line, accesses_);
+}
+
+std::string MemoryTiming::StatsString() const {
+  return "forwarded=" + std::to_string(forwarded_) +
+         ",l1_hits=" + std::to_string(l1_.hits_) +
+         ",l1_misses=" + std::to_string(l1_.misses_) +
+         ",l2_hits=" + std::to_string(l2_.hits_) +
+         ",l2_misses=" + std::to_string(l2_.misses_);
+}
+
+size_t MemoryTiming::ApproxBytes() const {
+  return (l1_.lines_.size() + l2_.lines_.size()) * 2 * sizeof(uint64_t);
+}
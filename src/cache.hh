@@ -0,0 +1,55 @@
+#pragma once
+
+#include "config.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One set-associative cache level with LRU replacement.
+// Only the line numbers are kept, the data lives in the simulator memory.
+class CacheLevel {
+public:
+  size_t num_sets_{0}; // 0 for no such level
+  size_t num_ways_{0};
+  std::vector<uint64_t> lines_;    // set by set, kNoLine when invalid
+  std::vector<uint64_t> last_use_; // of every way, for LRU
+  size_t hits_{0};
+  size_t misses_{0};
+
+  static constexpr uint64_t kNoLine = UINT64_MAX;
+
+  CacheLevel() = default;
+  CacheLevel(size_t num_sets, size_t num_ways);
+  bool Enabled() const { return num_sets_ != 0; }
+  // Look up line at time now, filling it on a miss over the least recently
+  // used way. Return true on a hit.
+  bool Access(uint64_t line, uint64_t now);
+};
+
+// Timing of the memory accesses: the L1/L2 caches and the loads that take
+// their data from an older store instead.
+class MemoryTiming {
+public:
+  CacheLevel l1_;
+  CacheLevel l2_;
+  int line_bytes_{64};
+  uint64_t accesses_{0}; // the LRU clock
+  size_t forwarded_{0};
+
+  MemoryTiming() = default;
+  explicit MemoryTiming(const MachineConfig &config);
+  bool Enabled() const { return l1_.Enabled(); }
+  // Access the line holding address, which is a line of its own when
+  // symbolic, and return the latency of a load: the hit latency of the
+  // level it is found in plus those of the levels above it.
+  int Load(uint64_t address, bool symbolic, const MachineConfig &config);
+  // stores are written back in the background, write-allocate
+  void Store(uint64_t address, bool symbolic);
+  // forwarded=n,l1_hits=n,... with ','
+  std::string StatsString() const;
+  size_t ApproxBytes() const;
+
+private:
+  uint64_t Line(uint64_t address, bool symbolic) const;
+};
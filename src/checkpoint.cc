@@ -0,0 +1,494 @@
+#include "checkpoint.hh"
+#include "cache.hh"
+#include "config.hh"
+#include "expr.hh"
+#include "memory.hh"
+#include "simulator.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// NONE stands for no instruction, e.g. on a free station
+bool IsValidOp(InstOp op) {
+  const int value = static_cast<int>(op);
+  return value >= 0 && value <= static_cast<int>(InstOp::NONE);
+}
+
+// Appends the fields of a checkpoint to buffer_
+class Writer {
+public:
+  std::string buffer_;
+
+  template <class T> void Put(const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>, "copied bytewise");
+    buffer_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+  void PutBool(bool value) { Put<uint8_t>(value); }
+  void PutString(const std::string &text) {
+    Put<uint64_t>(text.size());
+    buffer_ += text;
+  }
+  // of a type without padding
+  template <class T> void PutVector(const std::vector<T> &values) {
+    Put<uint64_t>(values.size());
+    buffer_.append(reinterpret_cast<const char *>(values.data()),
+                   values.size() * sizeof(T));
+  }
+  // field by field, so that no padding byte ends up in the file
+  void PutValue(const Value &value) {
+    Put(value.expr_);
+    PutBool(value.is_num_);
+    Put(value.num_);
+  }
+  void PutValues(const std::vector<Value> &values) {
+    Put<uint64_t>(values.size());
+    for (const Value &value : values) {
+      PutValue(value);
+    }
+  }
+  void PutCacheLevel(const CacheLevel &level) {
+    Put<uint64_t>(level.num_sets_);
+    Put<uint64_t>(level.num_ways_);
+    PutVector(level.lines_);
+    PutVector(level.last_use_);
+    Put<uint64_t>(level.hits_);
+    Put<uint64_t>(level.misses_);
+  }
+};
+
+// Reads the fields back in the same order. Past the end, on a count that
+// cannot fit in what is left or on an opcode out of range, ok_ turns false
+// and every read after that returns zeros.
+class Reader {
+public:
+  bool ok_{true};
+
+  Reader(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+  bool AtEnd() const { return pos_ == size_; }
+
+  template <class T> T Get() {
+    T value{};
+    if (size_ - pos_ < sizeof(T)) {
+      ok_ = false;
+      return value;
+    }
+    std::memcpy(&value, data_ + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return value;
+  }
+  bool GetBool() { return Get<uint8_t>() != 0; }
+  // an InstOp, NONE included
+  InstOp GetOp() {
+    const InstOp op = Get<InstOp>();
+    if (!IsValidOp(op)) {
+      ok_ = false;
+      return InstOp::NONE;
+    }
+    return op;
+  }
+  // number of elements of element_bytes each to follow
+  size_t GetCount(size_t element_bytes) {
+    const uint64_t count = Get<uint64_t>();
+    if (count > (size_ - pos_) / element_bytes) {
+      ok_ = false;
+      return 0;
+    }
+    return static_cast<size_t>(count);
+  }
+  std::string GetString() {
+    const size_t size = GetCount(1);
+    std::string text(reinterpret_cast<const char *>(data_ + pos_), size);
+    pos_ += size;
+    return text;
+  }
+  template <class T> void GetVector(std::vector<T> &values) {
+    values.resize(GetCount(sizeof(T)));
+    if (!values.empty())
+      std::memcpy(values.data(), data_ + pos_, values.size() * sizeof(T));
+    pos_ += values.size() * sizeof(T);
+  }
+  Value GetValue() {
+    Value value;
+    value.expr_ = Get<ExprId>();
+    value.is_num_ = GetBool();
+    value.num_ = Get<double>();
+    return value;
+  }
+  void GetValues(std::vector<Value> &values) {
+    values.resize(GetCount(sizeof(ExprId) + 1 + sizeof(double)));
+    for (Value &value : values) {
+      value = GetValue();
+    }
+  }
+  void GetCacheLevel(CacheLevel &level) {
+    level.num_sets_ = Get<uint64_t>();
+    level.num_ways_ = Get<uint64_t>();
+    GetVector(level.lines_);
+    GetVector(level.last_use_);
+    level.hits_ = Get<uint64_t>();
+    level.misses_ = Get<uint64_t>();
+  }
+
+private:
+  const uint8_t *data_;
+  size_t size_;
+  size_t pos_{0};
+};
+
+// Nothing has happened to inst since it was decoded. Interactive runs decode
+// the whole program up front, so most instructions are usually still so.
+bool IsFresh(const Instruction &inst) {
+  return inst.result_.Empty() && inst.issue_time_ == -1 &&
+         inst.exec_begin_time_ == -1 && inst.exec_end_time_ == -1 &&
+         inst.write_time_ == -1 && inst.commit_time_ == -1 &&
+         inst.ready_time_ == -1 && inst.station_ == kNoStation &&
+         !inst.predicted_taken_ && inst.raw_producer_ == InstOp::NONE &&
+         !inst.forwarded_ && !inst.order_blocked_ &&
+         inst.unit_wait_time_ == -1;
+}
+
+void PutInstruction(Writer &writer, const Instruction &inst) {
+  writer.Put<uint64_t>(inst.pc_);
+  writer.Put(inst.instop_);
+  const bool fresh = IsFresh(inst);
+  writer.PutBool(fresh);
+  if (fresh) // decoding it again is all it takes
+    return;
+  // the rest of the decoded fields, to check the trace on loading
+  writer.Put(inst.rd_);
+  writer.Put(inst.rs_);
+  writer.Put(inst.rt_);
+  writer.Put(inst.imm_);
+  writer.PutValue(inst.result_);
+  writer.Put(inst.issue_time_);
+  writer.Put(inst.exec_begin_time_);
+  writer.Put(inst.exec_end_time_);
+  writer.Put(inst.write_time_);
+  writer.Put(inst.commit_time_);
+  writer.Put(inst.ready_time_);
+  writer.Put(inst.station_);
+  writer.PutBool(inst.predicted_taken_);
+  writer.Put(inst.raw_producer_);
+  writer.PutBool(inst.forwarded_);
+  writer.PutBool(inst.order_blocked_);
+  writer.Put(inst.unit_wait_time_);
+}
+
+// Decode the instruction again from source and fill in its dynamic state.
+// Return false if it is not the one in the checkpoint.
+bool GetInstruction(Reader &reader, InstructionSource &source,
+                    Instruction &inst) {
+  const uint64_t pc = reader.Get<uint64_t>();
+  const InstOp instop = reader.GetOp();
+  if (reader.GetBool()) // fresh
+    return reader.ok_ && source.Decode(pc, inst) && inst.instop_ == instop;
+  const RegId rd = reader.Get<RegId>();
+  const RegId rs = reader.Get<RegId>();
+  const RegId rt = reader.Get<RegId>();
+  const int imm = reader.Get<int>();
+  if (!reader.ok_ || !source.Decode(pc, inst) || inst.instop_ != instop ||
+      inst.rd_ != rd || inst.rs_ != rs || inst.rt_ != rt || inst.imm_ != imm)
+    return false;
+  inst.result_ = reader.GetValue();
+  inst.issue_time_ = reader.Get<Cycle>();
+  inst.exec_begin_time_ = reader.Get<Cycle>();
+  inst.exec_end_time_ = reader.Get<Cycle>();
+  inst.write_time_ = reader.Get<Cycle>();
+  inst.commit_time_ = reader.Get<Cycle>();
+  inst.ready_time_ = reader.Get<Cycle>();
+  inst.station_ = reader.Get<StationTag>();
+  inst.predicted_taken_ = reader.GetBool();
+  inst.raw_producer_ = reader.GetOp();
+  inst.forwarded_ = reader.GetBool();
+  inst.order_blocked_ = reader.GetBool();
+  inst.unit_wait_time_ = reader.Get<Cycle>();
+  return true;
+}
+
+// Whether the expression of value is in an arena of num_nodes nodes
+bool IsValidValue(const Value &value, size_t num_nodes) {
+  return value.expr_ == kNoExpr || value.expr_ < num_nodes;
+}
+
+} // namespace
+
+bool SaveCheckpoint(const TomasuloSimulator &sim, const std::string &path,
+                    std::string &error) {
+  Writer writer;
+  writer.buffer_.append(kCheckpointMagic, sizeof(kCheckpointMagic));
+  writer.PutString(sim.config_.Spec());
+  writer.PutBool(sim.numeric_);
+  writer.Put<uint64_t>(sim.clocks_);
+  writer.Put<uint64_t>(sim.raw_stalls_);
+  writer.Put<uint64_t>(sim.war_stalls_);
+  // values refer to the arena, so it comes first
+  writer.Put<uint64_t>(sim.arena_->nodes_.size());
+  for (const ExprNode &node : sim.arena_->nodes_) {
+    writer.Put(node.kind_);
+    writer.Put(node.value_);
+    writer.Put(node.lhs_);
+    writer.Put(node.rhs_);
+  }
+  writer.Put<uint64_t>(sim.first_seq_);
+  writer.Put<uint64_t>(sim.instructions_.size());
+  for (const Instruction &inst : sim.instructions_) {
+    PutInstruction(writer, inst);
+  }
+  writer.PutVector(sim.window_);
+  writer.Put<uint64_t>(sim.fetch_);
+
+  const ControlFlow &control = sim.control_;
+  writer.Put<uint64_t>(control.pc_);
+  writer.PutBool(control.fetch_blocked_);
+  writer.PutVector(control.predictor_.counters_);
+  for (const Value &value : control.committed_registers_) {
+    writer.PutValue(value);
+  }
+  writer.Put<uint64_t>(control.committed_);
+  writer.Put<uint64_t>(control.branches_);
+  writer.Put<uint64_t>(control.mispredicts_);
+  writer.Put<uint64_t>(control.branch_penalty_);
+  writer.Put<uint64_t>(control.flushed_);
+
+  writer.Put(sim.account_.run_);
+  writer.Put(sim.account_.by_op_);
+  writer.Put(sim.account_.retired_by_op_);
+  writer.Put(sim.account_.raw_by_producer_);
+
+  const MemoryTiming &memory_timing = sim.memory_timing_;
+  writer.PutCacheLevel(memory_timing.l1_);
+  writer.PutCacheLevel(memory_timing.l2_);
+  writer.Put<uint64_t>(memory_timing.accesses_);
+  writer.Put<uint64_t>(memory_timing.forwarded_);
+  for (const auto &free_at : sim.units_.free_at_) {
+    writer.PutVector(free_at);
+  }
+
+  const StationFile &stations = sim.stations_;
+  writer.PutVector(stations.instop_);
+  writer.PutVector(stations.busy_);
+  writer.PutVector(stations.time_);
+  writer.PutValues(stations.Vj_);
+  writer.PutValues(stations.Vk_);
+  writer.PutVector(stations.Qj_);
+  writer.PutVector(stations.Qk_);
+  writer.PutValues(stations.Address_);
+  writer.PutVector(stations.waited_on_);
+
+  for (const Value &value : sim.registers_) {
+    writer.PutValue(value);
+  }
+  writer.Put(sim.register_status_);
+  writer.Put<uint64_t>(sim.memory_.size());
+  for (const auto &[address, value] : sim.memory_) {
+    writer.Put(address);
+    writer.PutValue(value);
+  }
+  writer.Put<uint64_t>(sim.memory_image_.stores_.size());
+  for (const auto &[address, value] : sim.memory_image_.stores_) {
+    writer.Put(address);
+    writer.Put(value);
+  }
+
+  std::ofstream fout(path, std::ios::binary);
+  fout.write(writer.buffer_.data(),
+             static_cast<std::streamsize>(writer.buffer_.size()));
+  if (!fout) {
+    error = "Cannot write " + path;
+    return false;
+  }
+  return true;
+}
+
+bool LoadCheckpoint(TomasuloSimulator &sim, const std::string &path,
+                    std::string &error) {
+  MappedFile file;
+  if (!file.Open(path, error))
+    return false;
+  if (file.size_ < sizeof(kCheckpointMagic) ||
+      std::memcmp(file.data_, kCheckpointMagic, sizeof(kCheckpointMagic)) !=
+          0) {
+    error = path + ": not a checkpoint";
+    return false;
+  }
+  if (sim.source_ == nullptr) {
+    error = path + ": no trace to resume";
+    return false;
+  }
+  const std::string corrupt = path + ": corrupt checkpoint";
+  Reader reader(file.data_ + sizeof(kCheckpointMagic),
+                file.size_ - sizeof(kCheckpointMagic));
+  MachineConfig config;
+  if (!config.Parse(reader.GetString(), error) || !reader.ok_) {
+    error = corrupt;
+    return false;
+  }
+  const bool numeric = reader.GetBool();
+  const size_t clocks = reader.Get<uint64_t>();
+  const size_t raw_stalls = reader.Get<uint64_t>();
+  const size_t war_stalls = reader.Get<uint64_t>();
+
+  auto arena = std::make_shared<ExprArena>();
+  arena->nodes_.resize(reader.GetCount(sizeof(ExprKind) + sizeof(int32_t) +
+                                       2 * sizeof(ExprId)));
+  for (ExprId id = 0; id < arena->nodes_.size(); ++id) {
+    ExprNode &node = arena->nodes_[id];
+    node.kind_ = reader.Get<ExprKind>();
+    node.value_ = reader.Get<int32_t>();
+    node.lhs_ = reader.Get<ExprId>();
+    node.rhs_ = reader.Get<ExprId>();
+    // operands are always older
+    if ((node.lhs_ != kNoExpr && node.lhs_ >= id) ||
+        (node.rhs_ != kNoExpr && node.rhs_ >= id)) {
+      error = corrupt;
+      return false;
+    }
+    arena->index_.Emplace(node, id);
+  }
+  const size_t num_nodes = arena->nodes_.size();
+
+  StationFile stations(config.num_load_stations_, config.num_add_stations_,
+                       config.num_mult_stations_);
+  auto is_tag = [&stations](StationTag tag) {
+    return tag <= stations.Size();
+  };
+  const size_t first_seq = reader.Get<uint64_t>();
+  InstructionQueue instructions;
+  for (size_t n = reader.GetCount(1); n > 0; --n) {
+    Instruction inst;
+    if (!GetInstruction(reader, *sim.source_, inst)) {
+      error = reader.ok_ ? path + ": does not match the trace" : corrupt;
+      return false;
+    }
+    if (!is_tag(inst.station_) || !IsValidValue(inst.result_, num_nodes)) {
+      error = corrupt;
+      return false;
+    }
+    instructions.push_back(inst);
+  }
+  const size_t end_seq = first_seq + instructions.size();
+  std::vector<size_t> window;
+  reader.GetVector(window);
+  const size_t fetch = reader.Get<uint64_t>();
+  bool valid = fetch >= first_seq && fetch <= end_seq;
+  for (size_t seq : window) {
+    valid = valid && seq >= first_seq && seq < end_seq;
+  }
+
+  ControlFlow control;
+  control.pc_ = reader.Get<uint64_t>();
+  control.fetch_blocked_ = reader.GetBool();
+  reader.GetVector(control.predictor_.counters_);
+  valid = valid && control.predictor_.counters_.size() ==
+                       static_cast<size_t>(config.bht_entries_);
+  for (Value &value : control.committed_registers_) {
+    value = reader.GetValue();
+    valid = valid && IsValidValue(value, num_nodes);
+  }
+  control.committed_ = reader.Get<uint64_t>();
+  control.branches_ = reader.Get<uint64_t>();
+  control.mispredicts_ = reader.Get<uint64_t>();
+  control.branch_penalty_ = reader.Get<uint64_t>();
+  control.flushed_ = reader.Get<uint64_t>();
+
+  CycleAccount account;
+  account.run_ = reader.Get<CycleStack>();
+  account.by_op_ = reader.Get<decltype(account.by_op_)>();
+  account.retired_by_op_ = reader.Get<decltype(account.retired_by_op_)>();
+  account.raw_by_producer_ = reader.Get<decltype(account.raw_by_producer_)>();
+
+  // the caches and units must have the shape config gives them
+  MemoryTiming memory_timing(config);
+  const MemoryTiming empty_timing = memory_timing;
+  reader.GetCacheLevel(memory_timing.l1_);
+  reader.GetCacheLevel(memory_timing.l2_);
+  memory_timing.accesses_ = reader.Get<uint64_t>();
+  memory_timing.forwarded_ = reader.Get<uint64_t>();
+  for (const auto &[level, empty] :
+       {std::make_pair(&memory_timing.l1_, &empty_timing.l1_),
+        std::make_pair(&memory_timing.l2_, &empty_timing.l2_)}) {
+    valid = valid && level->num_sets_ == empty->num_sets_ &&
+            level->num_ways_ == empty->num_ways_ &&
+            level->lines_.size() == empty->lines_.size() &&
+            level->last_use_.size() == empty->last_use_.size();
+  }
+  FunctionalUnits units(config);
+  for (auto &free_at : units.free_at_) {
+    const size_t num_units = free_at.size();
+    reader.GetVector(free_at);
+    valid = valid && free_at.size() == num_units;
+  }
+
+  reader.GetVector(stations.instop_);
+  reader.GetVector(stations.busy_);
+  reader.GetVector(stations.time_);
+  reader.GetValues(stations.Vj_);
+  reader.GetValues(stations.Vk_);
+  reader.GetVector(stations.Qj_);
+  reader.GetVector(stations.Qk_);
+  reader.GetValues(stations.Address_);
+  reader.GetVector(stations.waited_on_);
+  const size_t num_stations = stations.Size();
+  valid = valid && stations.instop_.size() == num_stations &&
+          stations.busy_.size() == num_stations &&
+          stations.time_.size() == num_stations &&
+          stations.Vj_.size() == num_stations &&
+          stations.Vk_.size() == num_stations &&
+          stations.Qj_.size() == num_stations &&
+          stations.Qk_.size() == num_stations &&
+          stations.Address_.size() == num_stations &&
+          stations.waited_on_.size() == num_stations;
+  for (size_t i = 0; valid && i < num_stations; ++i) {
+    valid = IsValidOp(stations.instop_[i]) &&
+            IsValidOp(stations.waited_on_[i]) && is_tag(stations.Qj_[i]) &&
+            is_tag(stations.Qk_[i]) &&
+            IsValidValue(stations.Vj_[i], num_nodes) &&
+            IsValidValue(stations.Vk_[i], num_nodes) &&
+            IsValidValue(stations.Address_[i], num_nodes);
+  }
+
+  RegisterFile registers;
+  for (Value &value : registers) {
+    value = reader.GetValue();
+    valid = valid && IsValidValue(value, num_nodes);
+  }
+  const auto register_status = reader.Get<RegisterStatus>();
+  for (StationTag tag : register_status) {
+    valid = valid && is_tag(tag);
+  }
+  Memory memory;
+  for (size_t n = reader.GetCount(sizeof(ExprId)); n > 0; --n) {
+    const ExprId address = reader.Get<ExprId>();
+    const Value value = reader.GetValue();
+    valid = valid && address < num_nodes && IsValidValue(value, num_nodes);
+    memory[address] = value;
+  }
+  MemoryImage memory_image;
+  memory_image.image_ = sim.memory_image_.image_;
+  for (size_t n = reader.GetCount(2 * sizeof(uint64_t)); n > 0; --n) {
+    const uint64_t address = reader.Get<uint64_t>();
+    memory_image.stores_[address] = reader.Get<double>();
+  }
+  if (!valid || !reader.ok_ || !reader.AtEnd()) {
+    error = corrupt;
+    return false;
+  }
+  sim.Restore(SimulatorState(
+      clocks, raw_stalls, war_stalls, config, sim.source_,
+      std::move(instructions), first_seq, std::move(window), fetch,
+      std::move(control), account, std::move(memory_timing), std::move(units),
+      std::move(stations), registers, std::move(memory), register_status,
+      std::move(arena), numeric, std::move(memory_image)));
+  if (sim.record_history_) // the first cycle to look back to
+    sim.StoreState();
+  return true;
+}
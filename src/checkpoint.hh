@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+class TomasuloSimulator;
+
+// Checkpoint of a simulation, to resume it later without replaying it.
+// A header, then every part of the simulator state in turn, fields in host
+// byte order. The trace and the initial memory image are not part of it:
+// they are opened as for the saved run, and the instructions in the
+// checkpoint are decoded from the trace again and checked against it.
+constexpr char kCheckpointMagic[8] = {'T', 'O', 'M', 'A', 'C', 'K', 'P', '2'};
+
+// Write the state of sim, between two cycles, to path.
+// Return false and fill error if path cannot be written.
+bool SaveCheckpoint(const TomasuloSimulator &sim, const std::string &path,
+                    std::string &error);
+// Replace the state of sim, whose source_ is the trace of the saved run, by
+// the checkpoint at path; its history starts afresh. Return false and fill
+// error, leaving sim as it was, if path is not a valid checkpoint or does
+// not match the trace.
+bool LoadCheckpoint(TomasuloSimulator &sim, const std::string &path,
+                    std::string &error);
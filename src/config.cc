@@ -0,0 +1,137 @@
+#include "config.hh"
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace {
+
+class ConfigField {
+public:
+  const char *name_;
+  int MachineConfig::*member_;
+  int min_;
+  int max_;
+};
+
+// stations are tagged with 16 bits, so their total must stay well below that
+const ConfigField kConfigFields[] = {
+    {"load_stations", &MachineConfig::num_load_stations_, 1, 1024},
+    {"add_stations", &MachineConfig::num_add_stations_, 1, 1024},
+    {"mult_stations", &MachineConfig::num_mult_stations_, 1, 1024},
+    {"load_latency", &MachineConfig::loadstore_latency_, 1, 1 << 20},
+    {"add_latency", &MachineConfig::adddsubd_latency_, 1, 1 << 20},
+    {"mult_latency", &MachineConfig::multd_latency_, 1, 1 << 20},
+    {"div_latency", &MachineConfig::divd_latency_, 1, 1 << 20},
+    {"int_latency", &MachineConfig::int_latency_, 1, 1 << 20},
+    {"rob_entries", &MachineConfig::rob_entries_, 0, 1 << 16},
+    {"commit_width", &MachineConfig::commit_width_, 1, 1024},
+    {"bht_entries", &MachineConfig::bht_entries_, 1, 1 << 20},
+    {"issue_width", &MachineConfig::issue_width_, 1, 1024},
+    {"cdbs", &MachineConfig::num_cdbs_, 0, 1024},
+    {"l1_sets", &MachineConfig::l1_sets_, 0, 1 << 20},
+    {"l1_ways", &MachineConfig::l1_ways_, 1, 64},
+    {"l1_latency", &MachineConfig::l1_latency_, 1, 1 << 20},
+    {"l2_sets", &MachineConfig::l2_sets_, 0, 1 << 20},
+    {"l2_ways", &MachineConfig::l2_ways_, 1, 64},
+    {"l2_latency", &MachineConfig::l2_latency_, 1, 1 << 20},
+    {"memory_latency", &MachineConfig::memory_latency_, 1, 1 << 20},
+    {"line_bytes", &MachineConfig::line_bytes_, 8, 1 << 20},
+    {"load_units", &MachineConfig::num_load_units_, 0, 1024},
+    {"add_units", &MachineConfig::num_add_units_, 0, 1024},
+    {"mult_units", &MachineConfig::num_mult_units_, 0, 1024},
+    {"div_units", &MachineConfig::num_div_units_, 0, 1024},
+    {"int_units", &MachineConfig::num_int_units_, 0, 1024},
+    {"load_interval", &MachineConfig::load_interval_, 1, 1 << 20},
+    {"add_interval", &MachineConfig::add_interval_, 1, 1 << 20},
+    {"mult_interval", &MachineConfig::mult_interval_, 1, 1 << 20},
+    {"div_interval", &MachineConfig::div_interval_, 1, 1 << 20},
+    {"int_interval", &MachineConfig::int_interval_, 1, 1 << 20},
+};
+
+} // namespace
+
+bool MachineConfig::Set(const std::string &key, int value,
+                        std::string &error) {
+  for (const auto &field : kConfigFields) {
+    if (key != field.name_)
+      continue;
+    if (value < field.min_ || value > field.max_) {
+      error = key + " must be between " + std::to_string(field.min_) +
+              " and " + std::to_string(field.max_);
+      return false;
+    }
+    this->*field.member_ = value;
+    return true;
+  }
+  error = "Unknown machine parameter " + key;
+  return false;
+}
+
+bool ParseKeyValues(
+    const std::string &spec,
+    const std::function<bool(const std::string &, int, std::string &)> &set,
+    std::string &error) {
+  size_t begin = 0;
+  while (begin <= spec.size()) {
+    size_t end = spec.find(',', begin);
+    if (end == std::string::npos)
+      end = spec.size();
+    std::string item = spec.substr(begin, end - begin);
+    size_t eq = item.find('=');
+    char *value_end = nullptr;
+    long value = eq == std::string::npos
+                     ? 0
+                     : std::strtol(item.c_str() + eq + 1, &value_end, 10);
+    if (eq == std::string::npos || eq + 1 == item.size() ||
+        *value_end != '\0') {
+      error = "Expected key=value instead of \"" + item + "\"";
+      return false;
+    }
+    // anything beyond int is out of range anyway
+    value = std::max<long>(-1, std::min<long>(value, INT_MAX));
+    if (!set(item.substr(0, eq), static_cast<int>(value), error))
+      return false;
+    begin = end + 1;
+  }
+  return true;
+}
+
+bool MachineConfig::Parse(const std::string &spec, std::string &error) {
+  return ParseKeyValues(
+      spec,
+      [this](const std::string &key, int value, std::string &error) {
+        return Set(key, value, error);
+      },
+      error);
+}
+
+void MachineConfig::HelpPrintHeader(std::ostream &os) {
+  const char *sep = "";
+  for (const auto &field : kConfigFields) {
+    os << sep << field.name_;
+    sep = "\t";
+  }
+}
+
+void MachineConfig::Print(std::ostream &os) const {
+  const char *sep = "";
+  for (const auto &field : kConfigFields) {
+    os << sep << this->*field.member_;
+    sep = "\t";
+  }
+}
+
+std::string MachineConfig::Spec() const {
+  std::string spec;
+  for (const auto &field : kConfigFields) {
+    if (!spec.empty())
+      spec += ',';
+    spec += field.name_;
+    spec += '=' + std::to_string(this->*field.member_);
+  }
+  return spec;
+}
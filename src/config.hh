@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+
+// Shape of the simulated machine: station counts and execution latencies
+class MachineConfig {
+public:
+  int num_load_stations_{3};
+  int num_add_stations_{3};
+  int num_mult_stations_{2};
+  int loadstore_latency_{2};
+  int adddsubd_latency_{2};
+  int multd_latency_{10};
+  int divd_latency_{40};
+  int int_latency_{1}; // DADDI and branches, on the add stations
+  // 0 for none: results go straight to the registers on writeback and
+  // fetch stops at every branch until it resolves
+  int rob_entries_{0};
+  int commit_width_{1};
+  int bht_entries_{1024}; // branch predictor counters
+  int issue_width_{1};    // instructions issued per cycle, in order
+  int num_cdbs_{0};       // results written back per cycle, 0 for no limit
+  // Caches, off with l1_sets_ 0: loads then take loadstore_latency_.
+  // Latencies add up level by level down to the one that hits.
+  int l1_sets_{0};
+  int l1_ways_{2};
+  int l1_latency_{2};
+  int l2_sets_{0}; // 0 for no L2
+  int l2_ways_{8};
+  int l2_latency_{10};
+  int memory_latency_{100};
+  int line_bytes_{64};
+  // Functional units of the load, add, mult, div and int latencies, shared
+  // by the stations; 0 for one per station, held until it finishes. A unit
+  // takes a new operation every interval cycles, 1 for fully pipelined.
+  int num_load_units_{0};
+  int num_add_units_{0};
+  int num_mult_units_{0};
+  int num_div_units_{0};
+  int num_int_units_{0};
+  int load_interval_{1};
+  int add_interval_{1};
+  int mult_interval_{1};
+  int div_interval_{1};
+  int int_interval_{1};
+
+  // Set the parameter called key, one of the names HelpPrintHeader() prints.
+  // Return false and fill error if key is unknown or value out of range.
+  bool Set(const std::string &key, int value, std::string &error);
+  // "key=value,key=value,..."
+  bool Parse(const std::string &spec, std::string &error);
+  // the parameter names / values, tab-separated
+  static void HelpPrintHeader(std::ostream &os);
+  void Print(std::ostream &os) const;
+  // every parameter as "key=value,...", for Parse()
+  std::string Spec() const;
+};
+
+// Split "key=value,key=value,..." and call set(key, value, error) for each
+// pair in turn. Return false and fill error on a malformed item or as soon
+// as set does.
+bool ParseKeyValues(
+    const std::string &spec,
+    const std::function<bool(const std::string &, int, std::string &)> &set,
+    std::string &error);
+
+// Machine shape known at compile time.
+// The simulator has a core specialized for each shape of FixedShapes (see
+// simulator.cc), with constant loop bounds and latencies; any other
+// configuration runs on the RuntimeShape core, which reads MachineConfig.
+template <int kLoad, int kAdd, int kMult, int kLoadLatency, int kAddLatency,
+          int kMultLatency, int kDivLatency>
+class FixedShape {
+public:
+  static constexpr bool kFixed = true;
+  static constexpr size_t kNumLoadStations = kLoad;
+  static constexpr size_t kNumStations = kLoad + kAdd + kMult;
+  static constexpr int kLoadStoreLatency = kLoadLatency;
+  static constexpr int kAddSubLatency = kAddLatency;
+  static constexpr int kMultDLatency = kMultLatency;
+  static constexpr int kDivDLatency = kDivLatency;
+
+  static bool Matches(const MachineConfig &config) {
+    return config.num_load_stations_ == kLoad &&
+           config.num_add_stations_ == kAdd &&
+           config.num_mult_stations_ == kMult &&
+           config.loadstore_latency_ == kLoadLatency &&
+           config.adddsubd_latency_ == kAddLatency &&
+           config.multd_latency_ == kMultLatency &&
+           config.divd_latency_ == kDivLatency;
+  }
+};
+
+class RuntimeShape {
+public:
+  static constexpr bool kFixed = false;
+  static constexpr size_t kNumLoadStations = 0;
+  static constexpr size_t kNumStations = 0;
+  static constexpr int kLoadStoreLatency = 0;
+  static constexpr int kAddSubLatency = 0;
+  static constexpr int kMultDLatency = 0;
+  static constexpr int kDivDLatency = 0;
+};
@@ -0,0 +1,419 @@
+#include "console.hh"
+#include "checkpoint.hh"
+#include "host_profile.hh"
+#include "simulator.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// The interactive front end: the command loop and the tables it prints.
+// Nothing in here runs while simulating, the engine itself never prints.
+
+std::string InstOpToStr(InstOp instop);
+
+static void HelpPrintInstructions(const InstructionQueue &instructions,
+                                  const size_t clocks, bool with_commit);
+static void HelpPrintLoadAndReservStations(const StationFile &stations,
+                                           const ExprArena &arena);
+static void HelpPrintRegisterStatus(const RegisterStatus &register_status,
+                                    const StationFile &stations);
+static void HelpPrintStatistic(const size_t clocks, const size_t raw_stalls,
+                               const size_t war_stalls,
+                               const ControlFlow &control,
+                               const MemoryTiming &memory_timing,
+                               bool with_rob);
+static void HelpPrintCycleStacks(const CycleAccount &account,
+                                 const InstructionQueue &instructions,
+                                 const size_t clocks);
+static void HelpPrintReservStation(const StationFile &stations, size_t index,
+                                   const ExprArena &arena);
+
+void PrintInstructions(const TomasuloSimulator &sim) {
+  HelpPrintInstructions(sim.instructions_, sim.clocks_, sim.RobMode());
+}
+void PrintLoadAndReservStations(const TomasuloSimulator &sim) {
+  HelpPrintLoadAndReservStations(sim.stations_, *sim.arena_);
+}
+void PrintRegisterStatus(const TomasuloSimulator &sim) {
+  HelpPrintRegisterStatus(sim.register_status_, sim.stations_);
+}
+void PrintStatistic(const TomasuloSimulator &sim) {
+  HelpPrintStatistic(sim.clocks_, sim.raw_stalls_, sim.war_stalls_,
+                     sim.control_, sim.memory_timing_, sim.RobMode());
+}
+void PrintCycleStacks(const TomasuloSimulator &sim) {
+  HelpPrintCycleStacks(sim.account_, sim.instructions_, sim.clocks_);
+}
+void PrintHostProfile(const TomasuloSimulator &sim) {
+  const HostProfile &host_profile = sim.host_profile_;
+  if (!host_profile.enabled_) {
+    std::cout << "Host profiling is off, start the simulator with -H\n";
+    return;
+  }
+  const auto ticks = host_profile.Ticks();
+  uint64_t total = 0;
+  uint64_t entries = 0;
+  for (size_t phase = 1; phase < kNumHostPhases; ++phase) {
+    total += ticks[phase];
+    entries += host_profile.entries_[phase];
+  }
+  const double ms_per_tick = host_profile.SecondsPerTick() * 1e3;
+  const auto flags = std::cout.flags();
+  const auto precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Host Profile\n";
+  std::cout << "Phase\t\tEntries\tms\tShare\n";
+  for (size_t phase = 1; phase < kNumHostPhases; ++phase) {
+    std::cout << std::left << std::setw(16)
+              << HostPhaseName(static_cast<HostPhase>(phase))
+              << host_profile.entries_[phase] << '\t'
+              << static_cast<double>(ticks[phase]) * ms_per_tick << '\t'
+              << (total == 0 ? 0.0
+                             : 100.0 * static_cast<double>(ticks[phase]) /
+                                   static_cast<double>(total))
+              << "%\n";
+  }
+  std::cout << std::left << std::setw(16) << "total" << entries << '\t'
+            << static_cast<double>(total) * ms_per_tick << '\t'
+            << (total == 0 ? 0.0 : 100.0) << "%\n";
+  std::cout.flags(flags);
+  std::cout.precision(precision);
+}
+void PrintAllInfo(const TomasuloSimulator &sim) {
+  PrintInstructions(sim);
+  PrintLoadAndReservStations(sim);
+  PrintRegisterStatus(sim);
+  PrintStatistic(sim);
+}
+void Run(TomasuloSimulator &sim) {
+  PrintInstructions(sim);
+  PrintLoadAndReservStations(sim);
+  PrintRegisterStatus(sim);
+  HelpPrintUsage();
+  bool is_terminated = false;
+  while (!is_terminated) {
+    std::cout << "Please input your command: ";
+    std::string cmd;
+    getline(std::cin, cmd);
+    std::istringstream iss(cmd);
+    char cmd_type;
+    iss >> cmd_type;
+    switch (cmd_type) {
+    case 'v': {
+      HostScope print(sim.host_profile_, HostPhase::PRINT);
+      char view_type;
+      if (!(iss >> view_type)) {
+        HelpPrintUsage();
+        break;
+      }
+      switch (view_type) {
+      case 'i':
+        PrintInstructions(sim);
+        break;
+      case 'l':
+        PrintLoadAndReservStations(sim);
+        break;
+      case 'r':
+        PrintRegisterStatus(sim);
+        break;
+      case 's':
+        PrintStatistic(sim);
+        break;
+      case 'a':
+        PrintAllInfo(sim);
+        break;
+      case 'c':
+        PrintCycleStacks(sim);
+        break;
+      case 'p':
+        PrintHostProfile(sim);
+        break;
+      default:
+        HelpPrintUsage();
+        break;
+      }
+    } break;
+    case 's':
+      long long steps;
+      if (!(iss >> steps)) {
+        Step(sim);
+      } else {
+        Step(sim, steps);
+      }
+      // PrintAllInfo();
+      break;
+    case 'r':
+      Step(sim, SIZE_MAX);
+      break;
+    case 'b':
+      long long backs;
+      if (!(iss >> backs)) {
+        Backtrace(sim);
+      } else {
+        Backtrace(sim, backs);
+      }
+      break;
+    case 'w':
+    case 'l': {
+      std::string path, error;
+      if (!(iss >> path)) {
+        HelpPrintUsage();
+        break;
+      }
+      if (cmd_type == 'w' ? !SaveCheckpoint(sim, path, error)
+                          : !LoadCheckpoint(sim, path, error)) {
+        std::cout << error << '\n';
+      } else if (cmd_type == 'l') {
+        std::cout << "Resumed at cycle " << sim.clocks_ << '\n';
+      }
+    } break;
+    case 'q':
+      std::cout << "Bye Bye\n";
+      is_terminated = true;
+      break;
+    default:
+      HelpPrintUsage();
+      break;
+    }
+  }
+}
+void Step(TomasuloSimulator &sim, size_t cycles) {
+  if (sim.IsFinish()) {
+    std::cerr << "!!!All the instructions has been executed!!!\n";
+    return;
+  }
+  sim.Advance(cycles);
+  HostScope print(sim.host_profile_, HostPhase::PRINT);
+  if (!sim.error_.empty()) {
+    std::cerr << sim.error_ << '\n';
+  } else if (sim.IsFinish()) {
+    std::cout << "!!!All the instructions are executed compeletely!!!\n";
+  }
+  PrintAllInfo(sim);
+}
+void Backtrace(TomasuloSimulator &sim, size_t cycles) {
+  if (cycles >= sim.clocks_ || cycles <= 0) {
+    std::cerr << "Please input a cycle clocks greater than 0 and less than "
+              << sim.clocks_ << '\n';
+    return;
+  }
+  const SimulatorState *checkpoint = sim.history_.FindCheckpoint(cycles);
+  if (checkpoint == nullptr) {
+    std::cerr << "No history was recorded for cycle " << cycles << '\n';
+    return;
+  }
+  TomasuloSimulator replay(*checkpoint);
+  replay.record_history_ = false;
+  replay.Advance(cycles - replay.clocks_);
+  HostScope print(sim.host_profile_, HostPhase::PRINT);
+  std::cout << "!!!Backtrace to cycle " << cycles << "!!!\n";
+  PrintAllInfo(replay);
+}
+void HelpPrintUsage() {
+  std::cout
+      << "Usage: \n"
+      << "v [i | l | r | s | a | c | p] : "
+         "display instructions status | load and reservation stations | "
+         "registers result status | statistics | all information aforesaid "
+         "| cycle stacks | host profile\n"
+      << "s [n(optional)] : step 1/n cycle(s)\n"
+      << "r : run to the end\n"
+      << "b [n] : look back the info of the simulator at the nth clock cycle\n"
+      << "w file : save a checkpoint of the current cycle to file\n"
+      << "l file : resume from the checkpoint in file\n"
+      << "q : quit the simulator\n";
+}
+static void HelpPrintInstructions(const InstructionQueue &instructions,
+                                  const size_t clocks, bool with_commit) {
+  std::cout << "Instruction Status\n";
+  std::cout << "Instruction\t\tIssue\tExec\tWrite"
+            << (with_commit ? "\tCommit\n" : "\n");
+  for (const Instruction &inst : instructions) {
+    std::cout << inst.text_ << '\t';
+    if (inst.issue_time_ != -1)
+      std::cout << inst.issue_time_;
+    std::cout << '\t';
+    if (inst.exec_begin_time_ != -1 &&
+        inst.exec_begin_time_ <= static_cast<Cycle>(clocks)) {
+      std::cout << inst.exec_begin_time_ << "~";
+      if (inst.exec_end_time_ != -1)
+        std::cout << inst.exec_end_time_;
+    }
+    std::cout << '\t';
+    if (inst.write_time_ != -1)
+      std::cout << inst.write_time_;
+    if (with_commit) {
+      std::cout << '\t';
+      if (inst.commit_time_ != -1)
+        std::cout << inst.commit_time_;
+    }
+    std::cout << "\t\n";
+  }
+}
+static void HelpPrintLoadAndReservStations(const StationFile &stations,
+                                           const ExprArena &arena) {
+  std::cout << "Load Stations\n";
+  std::cout << "Name\t\tBusy\tAddress\t\n";
+  for (size_t i = 0; i < stations.num_load_stations_; ++i) {
+    std::cout << stations.name_[i] << "\t\t"
+              << static_cast<bool>(stations.busy_[i]) << '\t'
+              << arena.ToString(stations.Address_[i]) << "\t\n";
+  }
+
+  std::cout << "Reservation Stations\n";
+  std::cout << std::left << "Time" << '\t' << "Name"
+            << "\t\t"
+            << "Busy\tOp\t" << std::setw(32) << "Vj" << '\t' << std::setw(32)
+            << "Vk"
+            << "\tQj\tQk\t\n";
+  for (size_t i = stations.num_load_stations_; i < stations.Size(); ++i) {
+    HelpPrintReservStation(stations, i, arena);
+  }
+}
+static void HelpPrintReservStation(const StationFile &stations, size_t index,
+                                   const ExprArena &arena) {
+  if (stations.time_[index] != -1) {
+    std::cout << std::left << stations.time_[index];
+  }
+  std::cout << std::left << '\t' << stations.name_[index] << "\t\t"
+            << static_cast<bool>(stations.busy_[index]) << '\t';
+  if (!stations.busy_[index]) {
+    std::cout << "\t\n";
+    return;
+  }
+  std::cout << std::left << InstOpToStr(stations.instop_[index]) << '\t'
+            << std::setw(32) << arena.ToString(stations.Vj_[index]) << '\t'
+            << std::setw(32) << arena.ToString(stations.Vk_[index]) << '\t';
+  if (stations.Qj_[index] != kNoStation) {
+    std::cout << stations.Name(stations.Qj_[index]);
+  }
+  std::cout << '\t';
+  if (stations.Qk_[index] != kNoStation) {
+    std::cout << stations.Name(stations.Qk_[index]);
+  }
+  std::cout << "\t\n";
+}
+static void HelpPrintRegisterStatus(const RegisterStatus &register_status,
+                                    const StationFile &stations) {
+  std::cout << "Register Result Status\n";
+  std::cout << "Reg\t";
+  for (int i = 0; i <= 30; i += 2) {
+    std::cout << "F" << i << '\t';
+  }
+  std::cout << '\n';
+  std::cout << "FU\t";
+  for (int i = 0; i <= 30; i += 2) {
+    if (register_status[i] != kNoStation) {
+      std::cout << stations.Name(register_status[i]);
+    }
+    std::cout << '\t';
+  }
+  std::cout << "\t\n";
+}
+
+static void HelpPrintStatistic(const size_t clocks, const size_t raw_stalls,
+                               const size_t war_stalls,
+                               const ControlFlow &control,
+                               const MemoryTiming &memory_timing,
+                               bool with_rob) {
+  std::cout << "Statistic\n";
+  std::cout << "Total:\n\t" << clocks << " cycle clocks executed\n";
+  std::cout << "Stalls:\n"
+            << "\tRAW stalls: " << raw_stalls << "\n"
+            << "\tWAR stalls: " << war_stalls << "\n"
+            << "\tTotal: " << raw_stalls + war_stalls << "\n";
+  if (memory_timing.Enabled() || memory_timing.forwarded_ != 0) {
+    std::cout << "Memory:\n"
+              << "\t" << memory_timing.forwarded_ << " loads forwarded\n";
+    if (memory_timing.Enabled()) {
+      std::cout << "\tL1: " << memory_timing.l1_.hits_ << " hits, "
+                << memory_timing.l1_.misses_ << " misses\n";
+    }
+    if (memory_timing.l2_.Enabled()) {
+      std::cout << "\tL2: " << memory_timing.l2_.hits_ << " hits, "
+                << memory_timing.l2_.misses_ << " misses\n";
+    }
+  }
+  if (!with_rob && control.branches_ == 0)
+    return;
+  std::cout << "Branches:\n"
+            << "\t" << control.branches_ << " resolved, "
+            << control.mispredicts_ << " mispredicted\n"
+            << "\tPenalty: " << control.branch_penalty_ << " cycles\n"
+            << "\tSquashed: " << control.flushed_ << " instructions\n";
+  if (!with_rob)
+    return;
+  std::cout << "Commit:\n\t" << control.committed_
+            << " instructions committed, "
+            << (clocks == 0 ? 0.0
+                            : static_cast<double>(control.committed_) / clocks)
+            << " per cycle\n";
+}
+static void HelpPrintCycleStacks(const CycleAccount &account,
+                                 const InstructionQueue &instructions,
+                                 const size_t clocks) {
+  const size_t retired = account.Retired();
+  const auto flags = std::cout.flags();
+  const auto precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Cycle Stack\n";
+  std::cout << "Kind\t\tCycles\tCPI\n";
+  for (size_t kind = 0; kind < kNumCycleKinds; ++kind) {
+    std::cout << std::left << std::setw(16)
+              << CycleKindName(static_cast<CycleKind>(kind))
+              << account.run_[kind] << '\t'
+              << (retired == 0 ? 0.0
+                               : static_cast<double>(account.run_[kind]) /
+                                     retired)
+              << '\n';
+  }
+  std::cout << std::left << std::setw(16) << "total" << clocks << '\t'
+            << (retired == 0 ? 0.0 : static_cast<double>(clocks) / retired)
+            << '\n';
+  // FRONTEND cycles belong to no instruction
+  const size_t num_kinds = static_cast<size_t>(CycleKind::FRONTEND);
+  std::cout << "Cycles per Instruction by Opcode\nOp\tCount";
+  for (size_t kind = 0; kind < num_kinds; ++kind) {
+    std::cout << '\t' << CycleKindName(static_cast<CycleKind>(kind));
+  }
+  std::cout << '\n';
+  for (size_t op = 0; op < kNumInstOps; ++op) {
+    const size_t count = account.retired_by_op_[op];
+    if (count == 0)
+      continue;
+    std::cout << InstOpToStr(static_cast<InstOp>(op)) << '\t' << count;
+    for (size_t kind = 0; kind < num_kinds; ++kind) {
+      std::cout << '\t'
+                << static_cast<double>(account.by_op_[op][kind]) / count;
+    }
+    std::cout << '\n';
+  }
+  std::cout << "RAW Cycles by Producer\n";
+  for (size_t op = 0; op < kNumInstOps; ++op) {
+    if (account.raw_by_producer_[op] != 0) {
+      std::cout << InstOpToStr(static_cast<InstOp>(op)) << '\t'
+                << account.raw_by_producer_[op] << '\n';
+    }
+  }
+  std::cout << "Instruction Cycles\nInstruction\t";
+  for (size_t kind = 0; kind < num_kinds; ++kind) {
+    std::cout << '\t' << CycleKindName(static_cast<CycleKind>(kind));
+  }
+  std::cout << '\n';
+  for (const Instruction &inst : instructions) {
+    std::cout << inst.text_ << '\t';
+    if (inst.write_time_ != -1) {
+      const CycleStack cycles = InstructionCycles(inst);
+      for (size_t kind = 0; kind < num_kinds; ++kind) {
+        std::cout << '\t' << cycles[kind];
+      }
+    }
+    std::cout << '\n';
+  }
+  std::cout.flags(flags);
+  std::cout.precision(precision);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "simulator.hh"
+#include <cstddef>
+
+// The interactive front end, in console.cc and not part of TomasuloCore:
+// the command loop, and the tables it prints to std::cout.
+
+// read commands from std::cin until q
+void Run(TomasuloSimulator &sim);
+// advance cycles cycles and print every table
+void Step(TomasuloSimulator &sim, size_t cycles = 1);
+// print the tables as they were at cycle cycles, replayed from history_
+void Backtrace(TomasuloSimulator &sim, size_t cycles = 1);
+void PrintInstructions(const TomasuloSimulator &sim);
+void PrintLoadAndReservStations(const TomasuloSimulator &sim);
+void PrintRegisterStatus(const TomasuloSimulator &sim);
+void PrintStatistic(const TomasuloSimulator &sim);
+void PrintAllInfo(const TomasuloSimulator &sim);
+void PrintCycleStacks(const TomasuloSimulator &sim);
+void PrintHostProfile(const TomasuloSimulator &sim);
+void HelpPrintUsage();
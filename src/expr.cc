@@ -0,0 +1,117 @@
+#include "expr.hh"
+#include "util.hh"
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+ExprId ExprArena::Intern(const ExprNode &node) {
+  auto [id, inserted] =
+      index_.Emplace(node, static_cast<ExprId>(nodes_.size()));
+  if (inserted)
+    nodes_.push_back(node);
+  return *id;
+}
+
+ExprId ExprArena::Reg(int reg) {
+  return Intern({ExprKind::REG, reg, kNoExpr, kNoExpr});
+}
+
+ExprId ExprArena::Imm(int imm) {
+  return Intern({ExprKind::IMM, imm, kNoExpr, kNoExpr});
+}
+
+ExprId ExprArena::Mem(ExprId address) {
+  return Intern({ExprKind::MEM, 0, address, kNoExpr});
+}
+
+ExprId ExprArena::Binary(ExprKind kind, ExprId lhs, ExprId rhs) {
+  return Intern({kind, 0, lhs, rhs});
+}
+
+std::string ExprArena::ToString(ExprId id) const {
+  std::string text;
+  if (id == kNoExpr)
+    return text;
+  // The DAG shares operands, so writing it out as a tree can take
+  // exponential space: a compound operand used more than once is written
+  // as #id{...} where it first appears and as #id after that. Both walks
+  // below take the operands in the order they are written and look at no
+  // more than kMaxExprText of them, as many as the text can show; a
+  // compound operand past those is written as #id alone.
+  std::unordered_map<ExprId, size_t> uses;
+  std::vector<ExprId> walk{id};
+  for (size_t seen = 0; seen < kMaxExprText && !walk.empty(); ++seen) {
+    const ExprId curr = walk.back();
+    walk.pop_back();
+    if (++uses[curr] > 1)
+      continue;
+    const ExprNode &node = nodes_[curr];
+    if (node.rhs_ != kNoExpr)
+      walk.push_back(node.rhs_);
+    if (node.lhs_ != kNoExpr)
+      walk.push_back(node.lhs_);
+  }
+  std::unordered_set<ExprId> written;
+  size_t seen = 0;
+  // iterative, dependency chains can be far deeper than the call stack
+  // each item is either a node to render or a literal piece of text
+  std::vector<std::pair<ExprId, const char *>> pending{{id, nullptr}};
+  while (!pending.empty()) {
+    if (text.size() > kMaxExprText) {
+      text.resize(kMaxExprText);
+      text += "...";
+      break;
+    }
+    auto [curr, literal] = pending.back();
+    pending.pop_back();
+    if (literal != nullptr) {
+      text += literal;
+      continue;
+    }
+    const ExprNode &node = nodes_[curr];
+    const bool counted = seen++ < kMaxExprText;
+    if (node.lhs_ != kNoExpr && (!counted || uses.find(curr)->second > 1)) {
+      text += "#" + std::to_string(curr);
+      if (!counted || !written.insert(curr).second)
+        continue;
+      text += "{";
+      pending.push_back({kNoExpr, "}"});
+    }
+    switch (node.kind_) {
+    case ExprKind::REG:
+      text += "Regs[" + RegName(static_cast<RegId>(node.value_)) + "]";
+      break;
+    case ExprKind::IMM:
+      text += std::to_string(node.value_);
+      break;
+    case ExprKind::MEM:
+      text += "Mem[";
+      pending.push_back({kNoExpr, "]"});
+      pending.push_back({node.lhs_, nullptr});
+      break;
+    case ExprKind::ADD:
+    case ExprKind::SUB:
+    case ExprKind::MUL:
+    case ExprKind::DIV: {
+      static const char *const kOps[] = {"+", "-", "*", "/"};
+      pending.push_back({node.rhs_, nullptr});
+      pending.push_back(
+          {kNoExpr, kOps[static_cast<int>(node.kind_) -
+                         static_cast<int>(ExprKind::ADD)]});
+      pending.push_back({node.lhs_, nullptr});
+    } break;
+    }
+  }
+  return text;
+}
+
+std::string ExprArena::ToString(const Value &value) const {
+  if (!value.is_num_)
+    return ToString(value.expr_);
+  std::ostringstream oss;
+  oss << value.num_;
+  return oss.str();
+}
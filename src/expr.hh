@@ -0,0 +1,82 @@
+#pragma once
+
+#include "flat_map.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Handle of a symbolic value in an ExprArena
+using ExprId = uint32_t;
+constexpr ExprId kNoExpr = UINT32_MAX;
+
+enum class ExprKind : uint8_t {
+  REG, // Regs[value_]
+  IMM, // value_
+  MEM, // Mem[lhs_]
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+};
+
+// Value of a register, operand, address or memory word.
+// Symbolic runs track expr_, numeric runs track num_; a cleared operand has
+// neither.
+class Value {
+public:
+  ExprId expr_{kNoExpr};
+  bool is_num_{false};
+  double num_{0.0};
+  static Value Expr(ExprId expr) { return {expr, false, 0.0}; }
+  static Value Num(double num) { return {kNoExpr, true, num}; }
+  bool Empty() const { return expr_ == kNoExpr && !is_num_; }
+};
+
+class ExprNode {
+public:
+  ExprKind kind_;
+  int32_t value_;
+  ExprId lhs_;
+  ExprId rhs_;
+  bool operator==(const ExprNode &other) const {
+    return kind_ == other.kind_ && value_ == other.value_ &&
+           lhs_ == other.lhs_ && rhs_ == other.rhs_;
+  }
+};
+
+class ExprNodeHash {
+public:
+  size_t operator()(const ExprNode &node) const {
+    uint64_t h = static_cast<uint64_t>(node.kind_) * 0x9e3779b97f4a7c15ULL;
+    h ^= static_cast<uint32_t>(node.value_) + (h << 6) + (h >> 2);
+    h ^= (static_cast<uint64_t>(node.lhs_) << 32 | node.rhs_) + (h << 6) +
+         (h >> 2);
+    return static_cast<size_t>(h);
+  }
+};
+
+constexpr size_t kMaxExprText = 4096;
+
+// Hash-consed DAG of symbolic values.
+// Every distinct expression is stored once, so building a result from its
+// operands costs O(1) whatever their size; text is only produced by
+// ToString() when a value is printed.
+class ExprArena {
+public:
+  std::vector<ExprNode> nodes_;
+  FlatMap<ExprNode, ExprId, ExprNodeHash> index_;
+
+  ExprId Reg(int reg);
+  ExprId Imm(int imm);
+  ExprId Mem(ExprId address);
+  ExprId Binary(ExprKind kind, ExprId lhs, ExprId rhs);
+  // Empty string for kNoExpr. Operands used more than once are named
+  // #id{...} the first time and #id after; longer text than kMaxExprText
+  // is cut and ends in "...".
+  std::string ToString(ExprId id) const;
+  std::string ToString(const Value &value) const;
+
+private:
+  ExprId Intern(const ExprNode &node);
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash map with linear probing, for trivially copyable keys
+// and values.
+// Every entry lives in one array, so a copy is a bulk copy of two vectors
+// with no per-entry allocation, and lookups and inserts of keys already
+// present allocate nothing. Entries are never removed, only cleared all at
+// once. Iteration order is unspecified.
+template <class Key, class Mapped, class Hash = std::hash<Key>>
+class FlatMap {
+public:
+  using value_type = std::pair<Key, Mapped>;
+
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = FlatMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+
+    const_iterator(const FlatMap *map, size_t slot) : map_(map), slot_(slot) {
+      Skip();
+    }
+    const value_type &operator*() const { return map_->slots_[slot_]; }
+    const value_type *operator->() const { return &map_->slots_[slot_]; }
+    const_iterator &operator++() {
+      ++slot_;
+      Skip();
+      return *this;
+    }
+    bool operator==(const const_iterator &other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return slot_ != other.slot_;
+    }
+
+  private:
+    void Skip() {
+      while (slot_ < map_->used_.size() && !map_->used_[slot_])
+        ++slot_;
+    }
+    const FlatMap *map_;
+    size_t slot_;
+  };
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, used_.size()); }
+  void clear() {
+    slots_.clear();
+    used_.clear();
+    size_ = 0;
+  }
+  // nullptr if key is not there
+  const Mapped *Find(const Key &key) const {
+    if (size_ == 0)
+      return nullptr;
+    const size_t slot = Probe(key);
+    return used_[slot] ? &slots_[slot].second : nullptr;
+  }
+  // Insert key with mapped unless it is there. Return its value and
+  // whether it was inserted.
+  std::pair<Mapped *, bool> Emplace(const Key &key, const Mapped &mapped) {
+    // at most half full, so probes stay short
+    if (2 * (size_ + 1) > slots_.size())
+      Rehash(slots_.empty() ? 16 : 2 * slots_.size());
+    const size_t slot = Probe(key);
+    const bool inserted = !used_[slot];
+    if (inserted) {
+      used_[slot] = 1;
+      slots_[slot] = value_type(key, mapped);
+      ++size_;
+    }
+    return {&slots_[slot].second, inserted};
+  }
+  // inserted value-initialized if not there
+  Mapped &operator[](const Key &key) { return *Emplace(key, Mapped()).first; }
+  size_t ApproxBytes() const {
+    return slots_.size() * (sizeof(value_type) + sizeof(uint8_t));
+  }
+
+private:
+  // the slot of key, or the free one it would go to
+  size_t Probe(const Key &key) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = Hash()(key) * 0x9e3779b97f4a7c15ULL >> 32 & mask;
+    while (used_[slot] && !(slots_[slot].first == key))
+      slot = (slot + 1) & mask;
+    return slot;
+  }
+  void Rehash(size_t capacity) {
+    std::vector<value_type> slots(capacity);
+    std::vector<uint8_t> used(capacity, 0);
+    slots.swap(slots_);
+    used.swap(used_);
+    for (size_t i = 0; i < used.size(); ++i) {
+      if (!used[i])
+        continue;
+      const size_t slot = Probe(slots[i].first);
+      used_[slot] = 1;
+      slots_[slot] = slots[i];
+    }
+  }
+
+  std::vector<value_type> slots_; // size a power of two
+  std::vector<uint8_t> used_;
+  size_t size_{0};
+};
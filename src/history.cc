@@ -0,0 +1,51 @@
+#include "history.hh"
+#include "util.hh"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+History::History(size_t interval, size_t budget_bytes)
+    : interval_(interval == 0 ? 1 : interval), budget_bytes_(budget_bytes),
+      bytes_(0) {}
+
+bool History::NeedCheckpoint(size_t clocks) const {
+  if (checkpoints_.empty())
+    return true;
+  return clocks > checkpoints_.back().clocks_ && clocks % interval_ == 0;
+}
+
+void History::AddCheckpoint(SimulatorState &&state) {
+  bytes_ += state.ApproxBytes();
+  checkpoints_.push_back(std::move(state));
+  // thin out: keep the first checkpoint and the multiples of the new interval
+  while (budget_bytes_ != 0 && bytes_ > budget_bytes_ &&
+         checkpoints_.size() > 1) {
+    interval_ *= 2;
+    std::vector<SimulatorState> kept;
+    bytes_ = 0;
+    for (size_t i = 0; i < checkpoints_.size(); ++i) {
+      if (i != 0 && checkpoints_[i].clocks_ % interval_ != 0)
+        continue;
+      bytes_ += checkpoints_[i].ApproxBytes();
+      kept.push_back(std::move(checkpoints_[i]));
+    }
+    checkpoints_ = std::move(kept);
+  }
+}
+
+const SimulatorState *History::FindCheckpoint(size_t clocks) const {
+  auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), clocks,
+                             [](size_t clocks, const SimulatorState &state) {
+                               return clocks < state.clocks_;
+                             });
+  if (it == checkpoints_.begin())
+    return nullptr;
+  return &*std::prev(it);
+}
+
+void History::Clear() {
+  checkpoints_.clear();
+  bytes_ = 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "util.hh"
+#include <cstddef>
+#include <vector>
+
+// Execution history for Backtrace().
+// Instead of a snapshot per cycle, a full checkpoint is kept every interval_
+// cycles and any cycle in between is rebuilt by replaying from the checkpoint
+// before it. When the checkpoints outgrow budget_bytes_, every other one is
+// dropped and the interval doubles, so memory stays bounded.
+class History {
+public:
+  size_t interval_;
+  size_t budget_bytes_; // 0 for unlimited
+  size_t bytes_{0};
+  std::vector<SimulatorState> checkpoints_; // ascending clocks
+
+  explicit History(size_t interval = 64, size_t budget_bytes = 64 << 20);
+  bool NeedCheckpoint(size_t clocks) const;
+  void AddCheckpoint(SimulatorState &&state);
+  // latest checkpoint at or before clocks, nullptr if there is none
+  const SimulatorState *FindCheckpoint(size_t clocks) const;
+  void Clear();
+};
@@ -0,0 +1,87 @@
+#include "host_profile.hh"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+const char *HostPhaseName(HostPhase phase) {
+  static const char *const kNames[] = {
+      "idle",  "other", "commit", "execute", "writeback",
+      "issue", "snapshot", "skip", "trace", "print"};
+  static_assert(sizeof(kNames) / sizeof(kNames[0]) == kNumHostPhases,
+                "a name for every HostPhase");
+  return kNames[static_cast<size_t>(phase)];
+}
+
+uint64_t HostProfile::Now() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void HostProfile::Start() {
+  enabled_ = true;
+  ticks_.fill(0);
+  entries_.fill(0);
+  current_ = HostPhase::IDLE;
+  start_time_ = std::chrono::steady_clock::now();
+  start_ticks_ = since_ = Now();
+}
+
+HostPhase HostProfile::Enter(HostPhase phase) {
+  const uint64_t now = Now();
+  ticks_[static_cast<size_t>(current_)] += now - since_;
+  since_ = now;
+  ++entries_[static_cast<size_t>(phase)];
+  const HostPhase outer = current_;
+  current_ = phase;
+  return outer;
+}
+
+void HostProfile::Leave(HostPhase outer) {
+  const uint64_t now = Now();
+  ticks_[static_cast<size_t>(current_)] += now - since_;
+  since_ = now;
+  current_ = outer;
+}
+
+std::array<uint64_t, kNumHostPhases> HostProfile::Ticks() const {
+  auto ticks = ticks_;
+  if (enabled_)
+    ticks[static_cast<size_t>(current_)] += Now() - since_;
+  return ticks;
+}
+
+double HostProfile::SecondsPerTick() const {
+  const uint64_t ticks = Now() - start_ticks_;
+  const std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start_time_;
+  return ticks == 0 ? 0.0 : seconds.count() / static_cast<double>(ticks);
+}
+
+std::string HostProfile::String() const {
+  if (!enabled_)
+    return "";
+  const auto ticks = Ticks();
+  const double ms_per_tick = SecondsPerTick() * 1e3;
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(3);
+  for (size_t phase = 1; phase < kNumHostPhases; ++phase) {
+    if (phase != 1)
+      oss << ',';
+    oss << HostPhaseName(static_cast<HostPhase>(phase)) << '='
+        << static_cast<double>(ticks[phase]) * ms_per_tick << ':'
+        << entries_[phase];
+  }
+  return oss.str();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Parts of the simulator's own work, to see where the host time goes.
+// IDLE is outside the simulator, e.g. waiting for a command, and is not
+// reported; OTHER is the rest of a step.
+enum class HostPhase {
+  IDLE,
+  OTHER,
+  COMMIT,
+  EXECUTE,   // the walk over the window, but its writebacks
+  WRITEBACK, // broadcasts on the common data bus and store writes
+  ISSUE,     // issue and fetch
+  SNAPSHOT,  // history checkpoints for Backtrace()
+  SKIP,      // jumping over quiet cycles
+  TRACE,     // pipeline trace records
+  PRINT,     // tables and state dumps
+  NONE,
+};
+constexpr size_t kNumHostPhases = static_cast<size_t>(HostPhase::NONE);
+
+const char *HostPhaseName(HostPhase phase);
+
+// Host time and entries of every phase, off unless Start()ed.
+// Time is read from the processor's cycle counter where there is one, so
+// moving between phases costs a few nanoseconds; every tick goes to the
+// phase innermost at the time, so the phases add up to the whole run.
+class HostProfile {
+public:
+  bool enabled_{false};
+  std::array<uint64_t, kNumHostPhases> entries_{};
+
+  // zero the counts and turn profiling on
+  void Start();
+  // Make phase the current one and return the one it interrupts, for
+  // Leave().
+  HostPhase Enter(HostPhase phase);
+  void Leave(HostPhase outer);
+  // ticks of every phase so far, the current one included
+  std::array<uint64_t, kNumHostPhases> Ticks() const;
+  // host seconds per tick, measured against the wall clock since Start()
+  double SecondsPerTick() const;
+  // "phase=milliseconds:entries,..." without IDLE, empty when off
+  std::string String() const;
+
+  static uint64_t Now();
+
+private:
+  std::array<uint64_t, kNumHostPhases> ticks_{};
+  HostPhase current_{HostPhase::IDLE};
+  uint64_t since_{0}; // when current_ was entered or resumed
+  uint64_t start_ticks_{0};
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+// Charges the time until its end to phase, when profiling is on
+class HostScope {
+public:
+  HostScope(HostProfile &profile, HostPhase phase)
+      : profile_(profile.enabled_ ? &profile : nullptr) {
+    if (profile_ != nullptr)
+      outer_ = profile_->Enter(phase);
+  }
+  HostScope(const HostScope &) = delete;
+  HostScope &operator=(const HostScope &) = delete;
+  ~HostScope() { End(); }
+  // back to the phase it interrupted, before the end of the scope
+  void End() {
+    if (profile_ != nullptr)
+      profile_->Leave(outer_);
+    profile_ = nullptr;
+  }
+
+private:
+  HostProfile *profile_;
+  HostPhase outer_{HostPhase::IDLE};
+};
@@ -1,62 +1,294 @@
+#include "batch.hh"
+#include "binary_trace.hh"
+#include "console.hh"
+#include "options.hh"
+#include "parser.hh"
+#include "sample.hh"
 #include "simulator.hh"
+#include "sweep.hh"
 #include "util.hh"
+#include "workload.hh"
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <memory>
-#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+static void PrintCommandLineUsage() {
+  std::cerr << "Usage: ./Simulator [options] [your  MIPS assembly code file]\n"
+            << "       ./Simulator -b [-j threads] [-o output] [options] "
+               "<trace | directory | @listfile>...\n"
+            << "       ./Simulator -s [-j threads] [-o output] "
+               "[-g key=values]... [options] "
+               "<trace | directory | @listfile>...\n"
+            << "       ./Simulator -e key=value,... [-j threads] "
+               "[-o output] [options] <trace>\n"
+            << "       ./Simulator -c <trace.S> <trace.tbin>\n"
+            << "       ./Simulator -w key=value,... <trace.S>\n"
+            << "Options:\n"
+            << "  -m MiB   memory budget of the backtrace history\n"
+            << "  -n       numeric mode, compute real values\n"
+            << "  -M file  initial memory image (implies -n)\n"
+            << "  -R file  initial register values (implies -n)\n"
+            << "  -d dir   dump the final state to dir/<trace>.state\n"
+            << "  -L file  resume from a checkpoint saved with the w "
+               "command\n"
+            << "  -P dir   write the pipeline trace to dir/<trace>.pipeview "
+               "(.jsonl)\n"
+            << "  -p fmt   pipeline trace format: o3 (O3PipeView, default), "
+               "json or json.gz\n"
+            << "  -S       simulate every cycle, no event-driven skipping\n"
+            << "  -G       always use the generic core, even for a machine "
+               "with a specialized one\n"
+            << "  -H       profile the simulator's own host time, see v p and "
+               "the batch rows\n"
+            << "  -C key=value,...  machine parameters, keys are "
+               "load_stations add_stations mult_stations\n"
+            << "                    load_latency add_latency mult_latency "
+               "div_latency\n"
+            << "                    int_latency rob_entries commit_width "
+               "bht_entries\n"
+            << "                    issue_width cdbs l1_sets l1_ways "
+               "l1_latency l2_sets\n"
+            << "                    l2_ways l2_latency memory_latency "
+               "line_bytes\n"
+            << "                    load_units add_units mult_units "
+               "div_units int_units\n"
+            << "                    load_interval add_interval "
+               "mult_interval div_interval\n"
+            << "                    int_interval\n"
+            << "  -g key=v1,lo:hi:step,...  sweep axis, the grid is the "
+               "product of all axes\n"
+            << "  -e key=value,...  sampled CPI estimate, keys are interval "
+               "warmup samples\n"
+            << "  -w key=value,...  synthetic trace, keys are length seed "
+               "dep_distance footprint\n"
+            << "                    and the weights load store add sub "
+               "mult div int\n";
+}
+
+static int RunConvertMode(int argc, char **argv) {
+  if (argc != 4) {
+    PrintCommandLineUsage();
+    return -1;
+  }
+  std::string error;
+  auto source = OpenTrace(argv[2], error);
+  if (source == nullptr || !WriteBinaryTrace(*source, argv[3], error)) {
+    std::cerr << error << '\n';
+    return -1;
+  }
+  return 0;
+}
+
+static int RunGenerateMode(int argc, char **argv) {
+  if (argc != 4) {
+    PrintCommandLineUsage();
+    return -1;
+  }
+  std::string error;
+  WorkloadSpec spec;
+  if (!spec.Parse(argv[2], error)) {
+    std::cerr << error << '\n';
+    return -1;
+  }
+  std::ofstream fout(argv[3]);
+  if (!fout) {
+    std::cerr << "Cannot open " << argv[3] << '\n';
+    return -1;
+  }
+  if (!GenerateWorkload(spec, fout, error)) {
+    std::cerr << error << '\n';
+    return -1;
+  }
+  return 0;
+}
+
+static int RunSampleMode(int argc, char **argv) {
+  size_t num_threads = std::thread::hardware_concurrency();
+  std::string output_path;
+  SimulationOptions options;
+  SampleSpec spec;
+  std::string path;
+  std::string error;
+  if (argc < 3 || !spec.Parse(argv[2], error)) {
+    if (!error.empty())
+      std::cerr << error << '\n';
+    PrintCommandLineUsage();
+    return -1;
+  }
+  for (int i = 3; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (options.Parse(argc, argv, i, error)) {
+      if (!error.empty()) {
+        std::cerr << error << '\n';
+        return -1;
+      }
+    } else if (arg == "-j" && i + 1 < argc) {
+      num_threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "-o" && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (path.empty()) {
+      path = arg;
+    } else {
+      PrintCommandLineUsage();
+      return -1;
+    }
+  }
+  if (path.empty()) {
+    std::cerr << "You did not provide MIPS file.\n";
+    PrintCommandLineUsage();
+    return -1;
+  }
+  if (!options.dump_dir_.empty() || !options.checkpoint_path_.empty() ||
+      !options.pipeline_dir_.empty()) {
+    std::cerr << "-d, -L and -P are not supported in sampling mode\n";
+    return -1;
+  }
+  std::ofstream fout;
+  if (!output_path.empty()) {
+    fout.open(output_path);
+    if (!fout) {
+      std::cerr << "Cannot open " << output_path << '\n';
+      return -1;
+    }
+  }
+  std::ostream &os = output_path.empty() ? std::cout : fout;
+  num_threads = num_threads == 0 ? 1 : num_threads;
+  SampleEstimate estimate = RunSampled(path, spec, num_threads, options);
+  if (!estimate.ok_) {
+    std::cerr << estimate.error_ << '\n';
+    return 1;
+  }
+  PrintSampleEstimate(estimate, os);
+  return 0;
+}
+
+// batch mode, or with sweep a design-space sweep over the -g grid
+static int RunBatchMode(int argc, char **argv, bool sweep) {
+  size_t num_threads = std::thread::hardware_concurrency();
+  std::string output_path;
+  SimulationOptions options;
+  SweepGrid grid;
+  std::vector<std::string> inputs;
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::string error;
+    if (options.Parse(argc, argv, i, error)) {
+      if (!error.empty()) {
+        std::cerr << error << '\n';
+        return -1;
+      }
+    } else if (sweep && arg == "-g" && i + 1 < argc) {
+      if (!grid.AddAxis(argv[++i], error)) {
+        std::cerr << error << '\n';
+        return -1;
+      }
+    } else if (arg == "-j" && i + 1 < argc) {
+      num_threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "-o" && i + 1 < argc) {
+      output_path = argv[++i];
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+  std::vector<std::string> paths = CollectTraceFiles(inputs);
+  if (paths.empty()) {
+    std::cerr << "You did not provide any MIPS file.\n";
+    PrintCommandLineUsage();
+    return -1;
+  }
+  std::ofstream fout;
+  if (!output_path.empty()) {
+    fout.open(output_path);
+    if (!fout) {
+      std::cerr << "Cannot open " << output_path << '\n';
+      return -1;
+    }
+  }
+  std::ostream &os = output_path.empty() ? std::cout : fout;
+  num_threads = num_threads == 0 ? 1 : num_threads;
+  if (sweep) {
+    if (!options.dump_dir_.empty() || !options.checkpoint_path_.empty() ||
+        !options.pipeline_dir_.empty()) {
+      std::cerr << "-d, -L and -P are not supported in sweep mode\n";
+      return -1;
+    }
+    HelpPrintSweepHeader(os);
+    size_t num_failed = RunSweep(paths, grid.Expand(options.config_),
+                                 num_threads, options, os);
+    if (num_failed != 0)
+      std::cerr << num_failed << " simulations failed\n";
+    return num_failed == 0 ? 0 : 1;
+  }
+  HelpPrintBatchHeader(os);
+  size_t num_failed = RunBatch(paths, num_threads, options, os, std::cerr);
+  return num_failed == 0 ? 0 : 1;
+}
 
 int main(int argc, char **argv) {
   if (argc < 2) {
-    std::cerr << "You did not provide MIPS file.\n"
-              << "Usage: ./Simulator [your  MIPS assembly code file]\n";
-    exit(-1);
-  }
-  std::vector<std::shared_ptr<Instruction>> instructions;
-  std::ifstream fin(argv[1]);
-  std::string curr_codeline;
-  while (std::getline(fin, curr_codeline)) {
-    std::istringstream iss(curr_codeline);
-    std::string opcode;
-    iss >> opcode;
-    InstOp instop;
-    if (opcode == "L.D")
-      instop = InstOp::LOAD;
-    else if (opcode == "S.D")
-      instop = InstOp::STORE;
-    else if (opcode == "ADD.D")
-      instop = InstOp::ADDD;
-    else if (opcode == "SUB.D")
-      instop = InstOp::SUBD;
-    else if (opcode == "MUL.D")
-      instop = InstOp::MULD;
-    else if (opcode == "DIV.D")
-      instop = InstOp::DIVD;
-    else {
-      std::cerr << "Operation " << opcode << " is not support!\n";
+    std::cerr << "You did not provide MIPS file.\n";
+    PrintCommandLineUsage();
+    exit(-1);
+  }
+  if (std::string(argv[1]) == "-b" || std::string(argv[1]) == "-s") {
+    return RunBatchMode(argc, argv, std::string(argv[1]) == "-s");
+  }
+  if (std::string(argv[1]) == "-e") {
+    return RunSampleMode(argc, argv);
+  }
+  if (std::string(argv[1]) == "-c") {
+    return RunConvertMode(argc, argv);
+  }
+  if (std::string(argv[1]) == "-w") {
+    return RunGenerateMode(argc, argv);
+  }
+  SimulationOptions options;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    std::string error;
+    if (!options.Parse(argc, argv, i, error)) {
+      path = argv[i];
+    } else if (!error.empty()) {
+      std::cerr << error << '\n';
       exit(-1);
     }
-    std::string op1, op2, op3;
-    iss >> op1 >> op2 >> op3;
-    switch (instop) {
-    case InstOp::LOAD:
-    case InstOp::STORE:
-      instructions.push_back(
-          std::make_shared<Instruction>(instop, curr_codeline, op2, op3, op1));
-      break;
-    case InstOp::ADDD:
-    case InstOp::SUBD:
-    case InstOp::MULD:
-    case InstOp::DIVD:
-      instructions.push_back(
-          std::make_shared<Instruction>(instop, curr_codeline, op1, op2, op3));
-      break;
-    default:
-      break;
-    }
   }
-  TomasuloSimulator mysim(std::move(instructions));
-  mysim.Run();
+  if (path.empty()) {
+    std::cerr << "You did not provide MIPS file.\n";
+    PrintCommandLineUsage();
+    exit(-1);
+  }
+  std::string error;
+  auto reader = OpenTrace(path, error);
+  if (reader == nullptr) {
+    std::cerr << error << '\n';
+    exit(-1);
+  }
+  TomasuloSimulator mysim(reader, options.config_);
+  if (!mysim.LoadAll(error)) {
+    std::cerr << error << '\n';
+    exit(-1);
+  }
+  options.Apply(mysim);
+  if (!options.Resume(mysim, error) ||
+      !options.OpenPipelineTrace(mysim, path, error)) {
+    std::cerr << error << '\n';
+    exit(-1);
+  }
+  Run(mysim);
+  if (!options.ClosePipelineTrace(mysim, error)) {
+    std::cerr << error << '\n';
+    exit(-1);
+  }
+  if (!mysim.error_.empty())
+    exit(-1);
+  if (!options.Dump(mysim, path, error)) {
+    std::cerr << error << '\n';
+    exit(-1);
+  }
   return 0;
-}
\ No newline at end of file
+}
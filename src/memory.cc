@@ -0,0 +1,57 @@
+#include "memory.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr)
+    munmap(const_cast<uint8_t *>(data_), size_);
+}
+
+bool MappedFile::Open(const std::string &path, std::string &error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "Cannot open " + path;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    error = "Cannot stat " + path;
+    return false;
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ != 0) {
+    void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      size_ = 0;
+      error = "Cannot map " + path;
+      return false;
+    }
+    data_ = static_cast<const uint8_t *>(addr);
+  }
+  close(fd);
+  return true;
+}
+
+double MemoryImage::Read(uint64_t address) const {
+  if (const double *stored = stores_.Find(address))
+    return *stored;
+  double value = 0.0;
+  if (image_ != nullptr && address < image_->size_) {
+    size_t num_bytes =
+        std::min<uint64_t>(sizeof(double), image_->size_ - address);
+    std::memcpy(&value, image_->data_ + address, num_bytes);
+  }
+  return value;
+}
+
+void MemoryImage::Write(uint64_t address, double value) {
+  stores_[address] = value;
+}
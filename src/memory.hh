@@ -0,0 +1,35 @@
+#pragma once
+
+#include "flat_map.hh"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Read-only file mapped into memory
+class MappedFile {
+public:
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+  // Return false and fill error if path cannot be mapped.
+  bool Open(const std::string &path, std::string &error);
+};
+
+// Byte-addressed memory of numeric runs.
+// The initial image is a mapped file shared by every simulator and snapshot;
+// stores go to a sparse overlay, so a snapshot only copies what the program
+// wrote, in one block. Accesses are 8-byte doubles named by their first
+// byte, and bytes beyond the image read as zero.
+class MemoryImage {
+public:
+  std::shared_ptr<const MappedFile> image_;
+  FlatMap<uint64_t, double> stores_;
+
+  double Read(uint64_t address) const;
+  void Write(uint64_t address, double value);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "util.hh"
+#include <cstddef>
+
+// Pipeline events of a simulation, for a program embedding the simulator.
+// Override the ones of interest; each gets the sequence number of the
+// instruction and the instruction with its times filled in up to the
+// event. They are called from inside the cycle being simulated, so they
+// must not step the simulator. A simulator with no observer pays one null
+// check per event.
+class SimulatorObserver {
+public:
+  virtual ~SimulatorObserver() = default;
+  // got a station, in program order
+  virtual void OnIssue(size_t, const Instruction &) {}
+  // began executing, its operands ready and a functional unit free
+  virtual void OnDispatch(size_t, const Instruction &) {}
+  // finished executing, its result computed
+  virtual void OnComplete(size_t, const Instruction &) {}
+  // wrote back: put its result on a common data bus, or a store got its
+  // data and address
+  virtual void OnWriteback(size_t, const Instruction &) {}
+  // left the reorder buffer, only with one
+  virtual void OnCommit(size_t, const Instruction &) {}
+};
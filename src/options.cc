@@ -0,0 +1,128 @@
+#include "options.hh"
+#include "checkpoint.hh"
+#include "memory.hh"
+#include "pipeline_trace.hh"
+#include "simulator.hh"
+#include "util.hh"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+
+bool SimulationOptions::Parse(int argc, char **argv, int &i,
+                              std::string &error) {
+  std::string arg = argv[i];
+  if (arg == "-n") {
+    numeric_ = true;
+    return true;
+  }
+  if (arg == "-S") {
+    event_driven_ = false;
+    return true;
+  }
+  if (arg == "-G") {
+    specialized_core_ = false;
+    return true;
+  }
+  if (arg == "-H") {
+    host_profile_ = true;
+    return true;
+  }
+  if (arg != "-M" && arg != "-R" && arg != "-d" && arg != "-m" &&
+      arg != "-C" && arg != "-L" && arg != "-P" && arg != "-p")
+    return false;
+  if (i + 1 >= argc) {
+    error = "Option " + arg + " needs an argument";
+    return true;
+  }
+  std::string value = argv[++i];
+  if (arg == "-M") {
+    auto image = std::make_shared<MappedFile>();
+    if (image->Open(value, error))
+      memory_image_ = std::move(image);
+    numeric_ = true;
+  } else if (arg == "-R") {
+    LoadRegisterImage(value, register_image_, error);
+    numeric_ = true;
+  } else if (arg == "-C") {
+    config_.Parse(value, error);
+  } else if (arg == "-P") {
+    pipeline_dir_ = value;
+  } else if (arg == "-p") {
+    if (value != "o3" && value != "json" && value != "json.gz")
+      error = "Pipeline trace formats are o3, json and json.gz";
+    pipeline_format_ = value;
+  } else if (arg == "-L") {
+    checkpoint_path_ = value;
+  } else if (arg == "-d") {
+    dump_dir_ = value;
+  } else {
+    history_budget_mib_ = std::strtoul(value.c_str(), nullptr, 10);
+  }
+  return true;
+}
+
+void SimulationOptions::Apply(TomasuloSimulator &sim) const {
+  sim.history_.budget_bytes_ = history_budget_mib_ << 20;
+  sim.event_driven_ = event_driven_;
+  sim.specialized_core_ = specialized_core_;
+  if (numeric_)
+    sim.EnableNumericMode(register_image_, memory_image_);
+  if (host_profile_)
+    sim.host_profile_.Start();
+}
+
+bool SimulationOptions::Resume(TomasuloSimulator &sim,
+                               std::string &error) const {
+  return checkpoint_path_.empty() ||
+         LoadCheckpoint(sim, checkpoint_path_, error);
+}
+
+bool SimulationOptions::OpenPipelineTrace(TomasuloSimulator &sim,
+                                          const std::string &trace_path,
+                                          std::string &error) const {
+  if (pipeline_dir_.empty())
+    return true;
+  const bool json = pipeline_format_ != "o3";
+  std::filesystem::path path = std::filesystem::path(pipeline_dir_) /
+                               std::filesystem::path(trace_path).stem();
+  path += json ? ".jsonl" : ".pipeview";
+  if (pipeline_format_ == "json.gz")
+    path += ".gz";
+  auto trace = std::make_shared<PipelineTrace>();
+  if (!trace->Open(path.string(),
+                   json ? PipelineTrace::Format::JSON
+                        : PipelineTrace::Format::O3PIPEVIEW,
+                   pipeline_format_ == "json.gz", error))
+    return false;
+  sim.pipeline_trace_ = std::move(trace);
+  return true;
+}
+
+bool SimulationOptions::ClosePipelineTrace(TomasuloSimulator &sim,
+                                           std::string &error) const {
+  if (sim.pipeline_trace_ == nullptr)
+    return true;
+  const bool ok = sim.pipeline_trace_->Close(error);
+  sim.pipeline_trace_ = nullptr;
+  return ok;
+}
+
+bool SimulationOptions::Dump(const TomasuloSimulator &sim,
+                             const std::string &trace_path,
+                             std::string &error) const {
+  if (dump_dir_.empty())
+    return true;
+  std::filesystem::path path = std::filesystem::path(dump_dir_) /
+                               std::filesystem::path(trace_path).stem();
+  path += ".state";
+  std::ofstream fout(path);
+  if (!fout) {
+    error = "Cannot open " + path.string();
+    return false;
+  }
+  sim.DumpArchState(fout);
+  return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "config.hh"
+#include "memory.hh"
+#include "util.hh"
+#include <memory>
+#include <string>
+
+class TomasuloSimulator;
+
+// How every trace is simulated, shared by interactive and batch runs
+class SimulationOptions {
+public:
+  MachineConfig config_;
+  bool numeric_{false};
+  RegisterImage register_image_{};
+  std::shared_ptr<const MappedFile> memory_image_;
+  std::string dump_dir_; // empty for no dump
+  size_t history_budget_mib_{64};
+  bool event_driven_{true};
+  bool specialized_core_{true};
+  std::string checkpoint_path_; // resume from it, empty for none
+  std::string pipeline_dir_;    // empty for no pipeline trace
+  std::string pipeline_format_{"o3"}; // o3, json or json.gz
+  bool host_profile_{false};
+
+  // Consume the option at argv[i] (and its argument) if it is one of
+  // -n, -M <memory image>, -R <register image>, -d <dump dir>, -m <MiB>, -S,
+  // -C <key=value,...>, -G, -L <checkpoint>, -P <pipeline trace dir>,
+  // -p <pipeline trace format>, -H.
+  // Return false if argv[i] is not such an option; error is set if it is
+  // one but cannot be applied.
+  bool Parse(int argc, char **argv, int &i, std::string &error);
+  void Apply(TomasuloSimulator &sim) const;
+  // Load the checkpoint to resume from into sim, after Apply(); true if
+  // there is none.
+  bool Resume(TomasuloSimulator &sim, std::string &error) const;
+  // Start the pipeline trace of the trace at trace_path in
+  // <pipeline_dir_>/<trace stem>.pipeview, .jsonl or .jsonl.gz, if asked.
+  bool OpenPipelineTrace(TomasuloSimulator &sim, const std::string &trace_path,
+                         std::string &error) const;
+  // Write the rest of the pipeline trace out, if there is one.
+  bool ClosePipelineTrace(TomasuloSimulator &sim, std::string &error) const;
+  // Write the final architectural state to <dump_dir_>/<trace stem>.state
+  bool Dump(const TomasuloSimulator &sim, const std::string &trace_path,
+            std::string &error) const;
+};
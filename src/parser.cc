@@ -0,0 +1,281 @@
+#include "parser.hh"
+#include "binary_trace.hh"
+#include "memory.hh"
+#include "util.hh"
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+bool IsBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Next whitespace-separated token of line starting at pos, empty at the end;
+// an empty token still points where the missing one would be.
+std::string_view NextToken(std::string_view line, size_t &pos) {
+  while (pos < line.size() && IsBlank(line[pos])) {
+    ++pos;
+  }
+  size_t begin = pos;
+  while (pos < line.size() && !IsBlank(line[pos])) {
+    ++pos;
+  }
+  return line.substr(begin, pos - begin);
+}
+
+bool ParseImm(std::string_view token, int &imm) {
+  if (!token.empty() && token[0] == '+')
+    token.remove_prefix(1);
+  const char *end = token.data() + token.size();
+  auto [ptr, ec] = std::from_chars(token.data(), end, imm);
+  return !token.empty() && ec == std::errc() && ptr == end;
+}
+
+// letters, digits, '_' and '.', not starting with a digit
+bool IsLabelName(std::string_view name) {
+  if (name.empty() || (name[0] >= '0' && name[0] <= '9'))
+    return false;
+  for (char c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '.')
+      return false;
+  }
+  return true;
+}
+
+// "name:" at the start of a line
+bool IsLabel(std::string_view token) {
+  return !token.empty() && token.back() == ':';
+}
+
+InstOp OpFromName(std::string_view opcode) {
+  if (opcode == "L.D")
+    return InstOp::LOAD;
+  if (opcode == "S.D")
+    return InstOp::STORE;
+  if (opcode == "ADD.D")
+    return InstOp::ADDD;
+  if (opcode == "SUB.D")
+    return InstOp::SUBD;
+  if (opcode == "MUL.D")
+    return InstOp::MULD;
+  if (opcode == "DIV.D")
+    return InstOp::DIVD;
+  if (opcode == "DADDI")
+    return InstOp::DADDI;
+  if (opcode == "BEQ")
+    return InstOp::BEQ;
+  if (opcode == "BNE")
+    return InstOp::BNE;
+  return InstOp::NONE;
+}
+
+} // namespace
+
+std::shared_ptr<TraceReader>
+TraceReader::FromFile(std::shared_ptr<const MappedFile> file,
+                      std::string name) {
+  auto reader = std::make_shared<TraceReader>();
+  reader->name_ = std::move(name);
+  reader->begin_ = reinterpret_cast<const char *>(file->data_);
+  reader->pos_ = reader->begin_;
+  reader->scan_pos_ = reader->begin_;
+  reader->end_ = reader->pos_ + file->size_;
+  reader->file_ = std::move(file);
+  return reader;
+}
+
+std::shared_ptr<TraceReader> TraceReader::FromString(std::string text,
+                                                     std::string name) {
+  auto reader = std::make_shared<TraceReader>();
+  reader->name_ = std::move(name);
+  reader->text_ = std::move(text);
+  reader->begin_ = reader->text_.data();
+  reader->pos_ = reader->begin_;
+  reader->scan_pos_ = reader->begin_;
+  reader->end_ = reader->pos_ + reader->text_.size();
+  return reader;
+}
+
+bool TraceReader::Fail(size_t line_number, std::string_view line,
+                       std::string_view at, const std::string &problem) {
+  error_ = name_ + ':' + std::to_string(line_number) + ':' +
+           std::to_string(at.data() - line.data() + 1) + ": " + problem;
+  pos_ = end_; // stay at the error
+  return false;
+}
+
+bool TraceReader::Decode(size_t pc, Instruction &inst) {
+  if (!error_.empty())
+    return false;
+  const Instruction &decoded = decoded_[pc & (kDecodedSize - 1)];
+  if (decoded.instop_ != InstOp::NONE && decoded.pc_ == pc) {
+    inst = decoded;
+    return true;
+  }
+  if (pc < next_pc_) { // a branch back, rescan from the line indexed before
+    const auto &[offset, line_number] = index_[pc / kIndexStride];
+    pos_ = begin_ + offset;
+    line_number_ = line_number;
+    next_pc_ = pc / kIndexStride * kIndexStride;
+  }
+  while (DecodeNext(inst)) {
+    decoded_[inst.pc_ & (kDecodedSize - 1)] = inst;
+    if (inst.pc_ == pc)
+      return true;
+  }
+  return false;
+}
+
+bool TraceReader::FindLabel(std::string_view name, size_t &pc) {
+  while (true) {
+    const auto it = labels_.find(name);
+    if (it != labels_.end()) {
+      pc = it->second;
+      return true;
+    }
+    if (scan_pos_ == end_ || !ScanLine())
+      return false;
+  }
+}
+
+bool TraceReader::ScanLine() {
+  const char *newline =
+      static_cast<const char *>(std::memchr(scan_pos_, '\n', end_ - scan_pos_));
+  const char *line_end = newline == nullptr ? end_ : newline;
+  std::string_view line(scan_pos_, line_end - scan_pos_);
+  scan_pos_ = newline == nullptr ? end_ : newline + 1;
+  ++scan_line_number_;
+  size_t pos = 0;
+  std::string_view token = NextToken(line, pos);
+  if (IsLabel(token)) {
+    const std::string_view name = token.substr(0, token.size() - 1);
+    if (!labels_.emplace(name, scan_pc_).second) {
+      return Fail(scan_line_number_, line, token,
+                  "Label " + std::string(name) + " is defined twice");
+    }
+    token = NextToken(line, pos);
+  }
+  if (!token.empty()) // an instruction
+    ++scan_pc_;
+  return true;
+}
+
+bool TraceReader::DecodeNext(Instruction &inst) {
+  if (next_pc_ == index_.size() * kIndexStride)
+    index_.emplace_back(pos_ - begin_, line_number_);
+  while (pos_ < end_) {
+    const char *newline =
+        static_cast<const char *>(std::memchr(pos_, '\n', end_ - pos_));
+    const char *line_end = newline == nullptr ? end_ : newline;
+    std::string_view line(pos_, line_end - pos_);
+    pos_ = newline == nullptr ? end_ : newline + 1;
+    ++line_number_;
+    size_t pos = 0;
+    std::string_view opcode = NextToken(line, pos);
+    if (IsLabel(opcode)) {
+      if (!IsLabelName(opcode.substr(0, opcode.size() - 1)))
+        return Fail(line, opcode, "Invalid label " + std::string(opcode));
+      // ScanLine() records it, and finds it defined twice
+      while (scan_pos_ <= line.data() && scan_pos_ != end_) {
+        if (!ScanLine())
+          return false;
+      }
+      opcode = NextToken(line, pos);
+    }
+    if (opcode.empty()) // blank line
+      continue;
+    // the instruction without its label
+    const std::string_view text = line.substr(opcode.data() - line.data());
+    const InstOp instop = OpFromName(opcode);
+    if (instop == InstOp::NONE) {
+      return Fail(line, opcode,
+                  "Operation " + std::string(opcode) + " is not support!");
+    }
+    std::string_view op1 = NextToken(line, pos);
+    std::string_view op2 = NextToken(line, pos);
+    std::string_view op3 = NextToken(line, pos);
+    auto invalid = [&](std::string_view at) {
+      return Fail(line, at,
+                  "Invalid operands in \"" + std::string(line) + "\"");
+    };
+    if (instop == InstOp::LOAD || instop == InstOp::STORE) {
+      // L.D/S.D ft offset base
+      RegId rt = RegFromName(op1);
+      RegId rs = RegFromName(op3);
+      int imm = 0;
+      if (rt == kNoReg)
+        return invalid(op1);
+      if (!ParseImm(op2, imm))
+        return invalid(op2);
+      if (rs == kNoReg)
+        return invalid(op3);
+      inst = Instruction(instop, text, kNoReg, rs, rt, imm);
+    } else if (instop == InstOp::DADDI) {
+      // DADDI rt rs imm
+      RegId rd = RegFromName(op1);
+      RegId rs = RegFromName(op2);
+      int imm = 0;
+      if (rd == kNoReg)
+        return invalid(op1);
+      if (rs == kNoReg)
+        return invalid(op2);
+      if (!ParseImm(op3, imm))
+        return invalid(op3);
+      inst = Instruction(instop, text, rd, rs, kNoReg, imm);
+    } else if (IsBranch(instop)) {
+      // BEQ/BNE rs rt offset, in instructions from the next one, or label
+      RegId rs = RegFromName(op1);
+      RegId rt = RegFromName(op2);
+      int imm = 0;
+      size_t target = 0;
+      if (rs == kNoReg)
+        return invalid(op1);
+      if (rt == kNoReg)
+        return invalid(op2);
+      if (!ParseImm(op3, imm)) {
+        if (!IsLabelName(op3))
+          return invalid(op3);
+        if (!FindLabel(op3, target)) {
+          if (!error_.empty()) // while reading on
+            return false;
+          return Fail(line, op3,
+                      "Label " + std::string(op3) + " is not defined");
+        }
+        imm = static_cast<int>(target) - static_cast<int>(next_pc_ + 1);
+      }
+      inst = Instruction(instop, text, kNoReg, rs, rt, imm);
+    } else {
+      // op fd fs ft
+      RegId rd = RegFromName(op1);
+      RegId rs = RegFromName(op2);
+      RegId rt = RegFromName(op3);
+      if (rd == kNoReg)
+        return invalid(op1);
+      if (rs == kNoReg)
+        return invalid(op2);
+      if (rt == kNoReg)
+        return invalid(op3);
+      inst = Instruction(instop, text, rd, rs, rt);
+    }
+    inst.pc_ = next_pc_++;
+    return true;
+  }
+  return false;
+}
+
+std::shared_ptr<InstructionSource> OpenTrace(const std::string &path,
+                                             std::string &error) {
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(path, error))
+    return nullptr;
+  if (IsBinaryTrace(*file))
+    return BinaryTraceReader::Open(std::move(file), path, error);
+  return TraceReader::FromFile(std::move(file), path);
+}
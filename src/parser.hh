@@ -0,0 +1,75 @@
+#pragma once
+
+#include "memory.hh"
+#include "util.hh"
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Streaming reader of MIPS assembly.
+// The file is mapped rather than read, and each line is tokenized in place
+// and decoded only when the simulator fetches it, so a trace of any length
+// costs little more memory than the instructions in flight: for branches
+// back, only the position of every kIndexStride-th instruction is kept. The
+// text_ of the instructions views the mapping; keep the reader alive while
+// they are used.
+// A line may start with a label, "name:", which branches can take as their
+// target instead of an offset. The last kDecodedSize instructions decoded
+// are kept, so a loop decodes its body once and then only copies it.
+class TraceReader : public InstructionSource {
+public:
+  // read the program from a mapped file, name is used in errors
+  static std::shared_ptr<TraceReader>
+  FromFile(std::shared_ptr<const MappedFile> file, std::string name);
+  // read the program from text, name is used in errors
+  static std::shared_ptr<TraceReader> FromString(std::string text,
+                                                 std::string name);
+  // Errors read "name:line:column: problem".
+  bool Decode(size_t pc, Instruction &inst) override;
+
+private:
+  static constexpr size_t kIndexStride = 64;
+  static constexpr size_t kDecodedSize = 1024; // a power of two
+
+  // the instruction at pos_, which is number next_pc_
+  bool DecodeNext(Instruction &inst);
+  // Find the pc of the label called name, reading on for the labels not
+  // seen yet. Return false if there is none or on an error.
+  bool FindLabel(std::string_view name, size_t &pc);
+  // record the label of the line at scan_pos_, if any, and move past it
+  bool ScanLine();
+  bool Fail(std::string_view line, std::string_view at,
+            const std::string &problem) {
+    return Fail(line_number_, line, at, problem);
+  }
+  bool Fail(size_t line_number, std::string_view line, std::string_view at,
+            const std::string &problem);
+
+  std::string name_;
+  std::shared_ptr<const MappedFile> file_;
+  std::string text_;
+  const char *begin_{nullptr};
+  const char *pos_{nullptr};
+  const char *end_{nullptr};
+  size_t line_number_{0}; // of the line before pos_
+  size_t next_pc_{0};
+  // offset and line_number_ of instruction i * kIndexStride
+  std::vector<std::pair<size_t, size_t>> index_;
+  // by pc modulo kDecodedSize, NONE when empty
+  std::array<Instruction, kDecodedSize> decoded_{};
+  // the labels before scan_pos_, by name, and the pc they stand for
+  std::unordered_map<std::string_view, size_t> labels_;
+  const char *scan_pos_{nullptr};
+  size_t scan_line_number_{0};
+  size_t scan_pc_{0};
+};
+
+// Open path as a binary trace if it is one, as assembly otherwise.
+// Return nullptr and fill error if it cannot be opened.
+std::shared_ptr<InstructionSource> OpenTrace(const std::string &path,
+                                             std::string &error);
@@ -0,0 +1,223 @@
+#include "pipeline_trace.hh"
+#include "util.hh"
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#ifdef TOMASULO_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+std::string InstOpToStr(InstOp instop);
+
+// without the temporary strings of std::to_string
+static void AppendInt(std::string &text, long long value) {
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  text.append(digits, result.ptr);
+}
+
+AsyncWriter::~AsyncWriter() {
+  std::string error;
+  Close(error);
+}
+
+bool AsyncWriter::Open(const std::string &path, bool compress,
+                       std::string &error) {
+  path_ = path;
+#ifdef TOMASULO_HAVE_ZLIB
+  if (compress) {
+    // the fastest level: compression runs on the writer thread, which
+    // must keep up with the simulation
+    gz_file_ = gzopen(path.c_str(), "wb1");
+    if (gz_file_ == nullptr) {
+      error = "Cannot open " + path;
+      return false;
+    }
+  }
+#else
+  if (compress) {
+    error = "Cannot compress " + path + ", built without zlib";
+    return false;
+  }
+#endif
+  if (!compress) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+      error = "Cannot open " + path;
+      return false;
+    }
+  }
+  buffer_.reserve(kBufferBytes);
+  thread_ = std::thread(&AsyncWriter::Run, this);
+  return true;
+}
+
+void AsyncWriter::Write(const char *data, size_t size) {
+  buffer_.append(data, size);
+  if (buffer_.size() >= kBufferBytes)
+    Flush();
+}
+
+void AsyncWriter::Flush() {
+  if (buffer_.empty())
+    return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return pending_.size() < kMaxPending; });
+  pending_.push_back(std::move(buffer_));
+  buffer_ = std::string();
+  buffer_.reserve(kBufferBytes);
+  changed_.notify_all();
+}
+
+void AsyncWriter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [this] { return closing_ || !pending_.empty(); });
+    if (pending_.empty()) // closing
+      break;
+    std::string data = std::move(pending_.front());
+    pending_.pop_front();
+    changed_.notify_all();
+    lock.unlock();
+    const bool ok = WriteOut(data);
+    lock.lock();
+    failed_ = failed_ || !ok;
+  }
+}
+
+bool AsyncWriter::WriteOut(const std::string &data) {
+  if (gz_file_ != nullptr) {
+#ifdef TOMASULO_HAVE_ZLIB
+    return gzwrite(static_cast<gzFile>(gz_file_), data.data(),
+                   static_cast<unsigned>(data.size())) ==
+           static_cast<int>(data.size());
+#endif
+  }
+  return std::fwrite(data.data(), 1, data.size(), file_) == data.size();
+}
+
+bool AsyncWriter::Close(std::string &error) {
+  if (!thread_.joinable())
+    return true;
+  Flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+    changed_.notify_all();
+  }
+  thread_.join();
+  bool ok = !failed_;
+  if (gz_file_ != nullptr) {
+#ifdef TOMASULO_HAVE_ZLIB
+    ok = gzclose(static_cast<gzFile>(gz_file_)) == Z_OK && ok;
+#endif
+    gz_file_ = nullptr;
+  }
+  if (file_ != nullptr)
+    ok = std::fclose(file_) == 0 && ok;
+  file_ = nullptr;
+  if (!ok)
+    error = "Cannot write " + path_;
+  return ok;
+}
+
+bool PipelineTrace::Open(const std::string &path, Format format,
+                         bool compress, std::string &error) {
+  format_ = format;
+  return writer_.Open(path, compress, error);
+}
+
+void PipelineTrace::Add(size_t seq, const Instruction &inst) {
+  line_.clear();
+  if (format_ == Format::O3PIPEVIEW) {
+    AddO3PipeView(seq, inst);
+  } else {
+    AddJson(seq, inst);
+  }
+  writer_.Write(line_);
+}
+
+void PipelineTrace::AddO3PipeView(size_t seq, const Instruction &inst) {
+  const Cycle fetch =
+      inst.ready_time_ != -1 ? inst.ready_time_ : inst.issue_time_;
+  const Cycle retire =
+      inst.commit_time_ != -1 ? inst.commit_time_ : inst.write_time_;
+  auto stage = [this](const char *name, Cycle cycle) {
+    line_ += "O3PipeView:";
+    line_ += name;
+    line_ += ':';
+    AppendInt(line_, static_cast<long long>(cycle) * 1000);
+  };
+  stage("fetch", fetch);
+  char pc[24];
+  std::snprintf(pc, sizeof(pc), ":0x%08zx:0:", inst.pc_ * 4);
+  line_ += pc;
+  AppendInt(line_, static_cast<long long>(seq));
+  line_ += ':';
+  line_ += inst.text_;
+  line_ += '\n';
+  for (const char *name : {"decode", "rename", "dispatch"}) {
+    stage(name, inst.issue_time_);
+    line_ += '\n';
+  }
+  stage("issue", inst.exec_begin_time_);
+  line_ += '\n';
+  stage("complete", inst.exec_end_time_);
+  line_ += '\n';
+  stage("retire", retire);
+  line_ += ":store:";
+  AppendInt(line_, inst.instop_ == InstOp::STORE
+                       ? static_cast<long long>(retire) * 1000
+                       : 0);
+  line_ += '\n';
+}
+
+void PipelineTrace::AddJson(size_t seq, const Instruction &inst) {
+  line_ += "{\"seq\":";
+  AppendInt(line_, static_cast<long long>(seq));
+  line_ += ",\"pc\":";
+  AppendInt(line_, static_cast<long long>(inst.pc_));
+  line_ += ",\"op\":\"";
+  line_ += InstOpToStr(inst.instop_);
+  line_ += "\",\"text\":\"";
+  for (char c : inst.text_) {
+    if (c == '"' || c == '\\') {
+      line_ += '\\';
+      line_ += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      line_ += ' ';
+    } else {
+      line_ += c;
+    }
+  }
+  line_ += '"';
+  const std::pair<const char *, Cycle> times[] = {
+      {"ready", inst.ready_time_},
+      {"issue", inst.issue_time_},
+      {"exec_begin", inst.exec_begin_time_},
+      {"exec_end", inst.exec_end_time_},
+      {"write", inst.write_time_},
+      {"commit", inst.commit_time_}};
+  for (const auto &[name, time] : times) {
+    line_ += ",\"";
+    line_ += name;
+    line_ += "\":";
+    AppendInt(line_, time);
+  }
+  line_ += ",\"cycles\":{";
+  const CycleStack cycles = InstructionCycles(inst);
+  for (size_t kind = 0; kind < kNumCycleKinds; ++kind) {
+    if (kind != 0)
+      line_ += ',';
+    line_ += '"';
+    line_ += CycleKindName(static_cast<CycleKind>(kind));
+    line_ += "\":";
+    AppendInt(line_, static_cast<long long>(cycles[kind]));
+  }
+  line_ += "}}\n";
+}
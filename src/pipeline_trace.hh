@@ -0,0 +1,77 @@
+#pragma once
+
+#include "util.hh"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// File written by a background thread.
+// Write() only appends to an in-memory buffer; every full buffer is handed
+// to the thread, which writes it out, gzip-compressed if asked, while the
+// caller goes on filling the next one. A caller more than a few buffers
+// ahead waits, so memory stays bounded.
+class AsyncWriter {
+public:
+  static constexpr size_t kBufferBytes = 1 << 22;
+  static constexpr size_t kMaxPending = 4; // full buffers queued
+
+  AsyncWriter() = default;
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter &operator=(const AsyncWriter &) = delete;
+  ~AsyncWriter();
+  // Return false and fill error if path cannot be created, or compress is
+  // asked for without zlib.
+  bool Open(const std::string &path, bool compress, std::string &error);
+  void Write(const char *data, size_t size);
+  void Write(const std::string &text) { Write(text.data(), text.size()); }
+  // Write out what is left and wait for the thread. Return false and fill
+  // error if any write failed.
+  bool Close(std::string &error);
+
+private:
+  void Flush(); // hand buffer_ to the thread
+  void Run();
+  bool WriteOut(const std::string &data);
+
+  std::string path_;
+  std::string buffer_;
+  std::FILE *file_{nullptr};
+  void *gz_file_{nullptr}; // gzFile, when compressed
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<std::string> pending_;
+  bool closing_{false};
+  bool failed_{false};
+};
+
+// Pipeline event log of the retired instructions, for a pipeline viewer.
+// O3PIPEVIEW is the gem5 O3PipeView text format, which Konata and the gem5
+// o3-pipeview script read: one cycle is 1000 ticks, fetch is the first
+// cycle an instruction could issue, decode, rename and dispatch its issue,
+// then issue and complete its execution and retire its writeback, or commit
+// with a reorder buffer. JSON has one object per line with every time of
+// the instruction and its cycles by kind, as in the cycle accounting.
+class PipelineTrace {
+public:
+  enum class Format { O3PIPEVIEW, JSON };
+
+  // Return false and fill error if path cannot be created.
+  bool Open(const std::string &path, Format format, bool compress,
+            std::string &error);
+  // inst, number seq, has just retired
+  void Add(size_t seq, const Instruction &inst);
+  bool Close(std::string &error) { return writer_.Close(error); }
+
+private:
+  void AddO3PipeView(size_t seq, const Instruction &inst);
+  void AddJson(size_t seq, const Instruction &inst);
+
+  Format format_{Format::O3PIPEVIEW};
+  AsyncWriter writer_;
+  std::string line_; // reused for every record
+};
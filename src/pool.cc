@@ -0,0 +1,81 @@
+#include "pool.hh"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// indices [begin_, end_) a thread has yet to run
+class TaskRange {
+public:
+  std::mutex mutex_;
+  size_t begin_{0};
+  size_t end_{0};
+};
+
+} // namespace
+
+void ParallelFor(size_t num_tasks, size_t num_threads,
+                 const std::function<void(size_t)> &task) {
+  num_threads = std::max<size_t>(1, std::min(num_threads, num_tasks));
+  std::vector<TaskRange> ranges(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    ranges[i].begin_ = num_tasks * i / num_threads;
+    ranges[i].end_ = num_tasks * (i + 1) / num_threads;
+  }
+  auto take_own = [&](size_t self, size_t &index) {
+    std::lock_guard<std::mutex> lock(ranges[self].mutex_);
+    if (ranges[self].begin_ == ranges[self].end_)
+      return false;
+    index = ranges[self].begin_++;
+    return true;
+  };
+  auto steal = [&](size_t self) {
+    size_t victim = self;
+    size_t most = 0;
+    for (size_t i = 0; i < num_threads; ++i) {
+      std::lock_guard<std::mutex> lock(ranges[i].mutex_);
+      if (ranges[i].end_ - ranges[i].begin_ > most) {
+        most = ranges[i].end_ - ranges[i].begin_;
+        victim = i;
+      }
+    }
+    if (most == 0)
+      return false;
+    size_t begin, end;
+    {
+      std::lock_guard<std::mutex> lock(ranges[victim].mutex_);
+      // it may have shrunk meanwhile; the victim keeps the lower half
+      TaskRange &range = ranges[victim];
+      if (range.begin_ == range.end_)
+        return true; // look again
+      end = range.end_;
+      begin = end - (end - range.begin_ + 1) / 2;
+      range.end_ = begin;
+    }
+    std::lock_guard<std::mutex> lock(ranges[self].mutex_);
+    ranges[self].begin_ = begin;
+    ranges[self].end_ = end;
+    return true;
+  };
+  auto worker = [&](size_t self) {
+    size_t index;
+    for (;;) {
+      if (take_own(self, index))
+        task(index);
+      else if (!steal(self))
+        return;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker, i);
+  }
+  worker(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Run task(0) .. task(num_tasks - 1) on num_threads threads, the caller's
+// among them, and return when all are done.
+// Every thread starts on its own contiguous share of the indices; one that
+// runs dry steals the upper half of the largest share left, so uneven task
+// costs still keep every thread busy without a shared queue to contend on.
+void ParallelFor(size_t num_tasks, size_t num_threads,
+                 const std::function<void(size_t)> &task);
@@ -0,0 +1,330 @@
+#include "sample.hh"
+#include "config.hh"
+#include "memory.hh"
+#include "options.hh"
+#include "parser.hh"
+#include "pool.hh"
+#include "simulator.hh"
+#include "util.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+class SampleField {
+public:
+  const char *name_;
+  int SampleSpec::*member_;
+  int min_;
+  int max_;
+};
+
+const SampleField kSampleFields[] = {
+    {"interval", &SampleSpec::interval_, 1, 1 << 30},
+    {"warmup", &SampleSpec::warmup_, 0, 1 << 30},
+    {"samples", &SampleSpec::samples_, 1, 1 << 20},
+};
+
+// simulated cycles between checks for the end of a sample
+constexpr size_t kSampleChunk = 256;
+
+// Architectural state before some instruction of the run
+class ArchState {
+public:
+  size_t executed_{0}; // instructions before it
+  size_t pc_{0};
+  RegisterImage registers_{};
+  MemoryImage memory_;
+};
+
+// Executes the program in order with no timing, to fast-forward to where
+// the samples start. Symbolic runs have no values to compute, their
+// programs are straight-line.
+class FunctionalCore {
+public:
+  ArchState state_;
+  std::string error_;
+
+  FunctionalCore(InstructionSource &source, const SimulationOptions &options)
+      : source_(source), numeric_(options.numeric_) {
+    state_.registers_ = options.register_image_;
+    state_.memory_.image_ = options.memory_image_;
+  }
+  // run the next instruction, false at the end of the program or on an
+  // error
+  bool Step();
+
+private:
+  uint64_t Address(const Instruction &inst) const {
+    const double address = inst.imm_ + state_.registers_[inst.rs_];
+    return static_cast<uint64_t>(static_cast<int64_t>(address));
+  }
+
+  InstructionSource &source_;
+  bool numeric_;
+};
+
+bool FunctionalCore::Step() {
+  Instruction inst;
+  if (!source_.Decode(state_.pc_, inst)) {
+    error_ = source_.error_;
+    return false;
+  }
+  state_.pc_ = inst.pc_ + 1;
+  ++state_.executed_;
+  if (!numeric_) {
+    if (IsBranch(inst.instop_)) {
+      error_ = "Branches need numeric mode (-n): " + std::string(inst.text_);
+      return false;
+    }
+    return true;
+  }
+  auto &regs = state_.registers_;
+  switch (inst.instop_) {
+  case InstOp::LOAD:
+    regs[inst.rt_] = state_.memory_.Read(Address(inst));
+    break;
+  case InstOp::STORE:
+    state_.memory_.Write(Address(inst), regs[inst.rt_]);
+    break;
+  case InstOp::ADDD:
+    regs[inst.rd_] = regs[inst.rs_] + regs[inst.rt_];
+    break;
+  case InstOp::SUBD:
+    regs[inst.rd_] = regs[inst.rs_] - regs[inst.rt_];
+    break;
+  case InstOp::MULD:
+    regs[inst.rd_] = regs[inst.rs_] * regs[inst.rt_];
+    break;
+  case InstOp::DIVD:
+    regs[inst.rd_] = regs[inst.rs_] / regs[inst.rt_];
+    break;
+  case InstOp::DADDI:
+    regs[inst.rd_] = regs[inst.rs_] + inst.imm_;
+    break;
+  case InstOp::BEQ:
+  case InstOp::BNE:
+    if ((regs[inst.rs_] == regs[inst.rt_]) == (inst.instop_ == InstOp::BEQ))
+      state_.pc_ = inst.pc_ + 1 + inst.imm_;
+    break;
+  case InstOp::NONE:
+    break;
+  }
+  return true;
+}
+
+// Simulate warmup instructions from start, then measure the next length.
+bool SimulateSample(const std::string &path, const ArchState &start,
+                    size_t warmup, size_t length,
+                    const SimulationOptions &options, SampleResult &result,
+                    std::string &error) {
+  auto source = OpenTrace(path, error);
+  if (source == nullptr)
+    return false;
+  TomasuloSimulator sim(source, options.config_);
+  options.Apply(sim);
+  sim.record_history_ = false;
+  sim.retain_instructions_ = false;
+  if (sim.numeric_) {
+    sim.EnableNumericMode(start.registers_, start.memory_.image_);
+    sim.memory_image_.stores_ = start.memory_.stores_;
+  }
+  sim.StartAt(start.pc_);
+  // Without a reorder buffer instructions write back out of order, so the
+  // sample is measured by in-order progress: an instruction counts once it
+  // and every older one have retired.
+  size_t retired = 0;
+  size_t next_seq = sim.first_seq_;
+  std::set<size_t> ahead; // retired before an older one
+  size_t begin_cycle = 0;
+  size_t end_cycle = 0;
+  sim.retire_sink_ = [&](size_t seq, const Instruction &inst) {
+    // Advance() runs past the end of the sample
+    if (retired >= warmup + length)
+      return;
+    const size_t before = retired;
+    ahead.insert(seq);
+    while (!ahead.empty() && *ahead.begin() == next_seq) {
+      ahead.erase(ahead.begin());
+      ++next_seq;
+      ++retired;
+    }
+    if (retired == before)
+      return;
+    end_cycle = static_cast<size_t>(
+        inst.commit_time_ != -1 ? inst.commit_time_ : inst.write_time_);
+    if (before < warmup && retired >= warmup)
+      begin_cycle = end_cycle;
+  };
+  while (!sim.IsFinish() && retired < warmup + length) {
+    sim.Advance(kSampleChunk);
+  }
+  if (!sim.error_.empty() || !source->error_.empty()) {
+    error = sim.error_.empty() ? source->error_ : sim.error_;
+    return false;
+  }
+  // the last sample may end with the program
+  result.first_ = start.executed_ + warmup;
+  result.instructions_ = std::min(retired, warmup + length) - warmup;
+  result.cycles_ = end_cycle - begin_cycle;
+  return true;
+}
+
+// two-sided 95% quantile of Student's t with dof degrees of freedom
+double StudentT95(size_t dof) {
+  static const double kTable[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  constexpr size_t kSize = sizeof(kTable) / sizeof(kTable[0]);
+  return dof <= kSize ? kTable[dof - 1] : 1.960;
+}
+
+} // namespace
+
+bool SampleSpec::Set(const std::string &key, int value, std::string &error) {
+  for (const auto &field : kSampleFields) {
+    if (key != field.name_)
+      continue;
+    if (value < field.min_ || value > field.max_) {
+      error = key + " must be between " + std::to_string(field.min_) +
+              " and " + std::to_string(field.max_);
+      return false;
+    }
+    this->*field.member_ = value;
+    return true;
+  }
+  error = "Unknown sampling parameter " + key;
+  return false;
+}
+
+bool SampleSpec::Parse(const std::string &spec, std::string &error) {
+  return ParseKeyValues(
+      spec,
+      [this](const std::string &key, int value, std::string &error) {
+        return Set(key, value, error);
+      },
+      error);
+}
+
+SampleEstimate RunSampled(const std::string &path, const SampleSpec &spec,
+                          size_t num_threads,
+                          const SimulationOptions &options) {
+  SampleEstimate estimate;
+  auto source = OpenTrace(path, estimate.error_);
+  if (source == nullptr)
+    return estimate;
+  // the length of the run, for where the samples go
+  {
+    FunctionalCore core(*source, options);
+    while (core.Step()) {
+    }
+    if (!core.error_.empty()) {
+      estimate.error_ = core.error_;
+      return estimate;
+    }
+    estimate.instructions_ = core.state_.executed_;
+  }
+  if (estimate.instructions_ == 0) {
+    estimate.error_ = path + ": no instructions";
+    return estimate;
+  }
+  const size_t interval = static_cast<size_t>(spec.interval_);
+  const size_t num_intervals =
+      (estimate.instructions_ + interval - 1) / interval;
+  const size_t num_samples =
+      std::min(num_intervals, static_cast<size_t>(spec.samples_));
+  // systematic sampling: the middle interval of every num_samples-th share
+  std::vector<ArchState> starts;
+  std::vector<size_t> warmups;
+  {
+    FunctionalCore core(*source, options);
+    for (size_t i = 0; i < num_samples; ++i) {
+      const size_t first = (2 * i + 1) * num_intervals / (2 * num_samples) *
+                           interval;
+      const size_t warmup =
+          std::min(first, static_cast<size_t>(spec.warmup_));
+      while (core.state_.executed_ < first - warmup) {
+        core.Step();
+      }
+      starts.push_back(core.state_);
+      warmups.push_back(warmup);
+    }
+  }
+  estimate.samples_.resize(num_samples);
+  std::vector<std::string> errors(num_samples);
+  ParallelFor(num_samples, num_threads, [&](size_t i) {
+    SimulateSample(path, starts[i], warmups[i], interval, options,
+                   estimate.samples_[i], errors[i]);
+  });
+  for (const auto &error : errors) {
+    if (!error.empty()) {
+      estimate.error_ = error;
+      return estimate;
+    }
+  }
+  // ratio estimate: the last interval may be shorter
+  double cycles = 0.0;
+  double instructions = 0.0;
+  for (const auto &sample : estimate.samples_) {
+    cycles += static_cast<double>(sample.cycles_);
+    instructions += static_cast<double>(sample.instructions_);
+  }
+  if (instructions == 0.0) {
+    estimate.error_ = path + ": no instruction retired in the samples";
+    return estimate;
+  }
+  estimate.cpi_ = cycles / instructions;
+  const double n = static_cast<double>(num_samples);
+  if (num_samples == num_intervals) { // every interval was simulated
+    estimate.cpi_ci95_ = 0.0;
+  } else if (num_samples == 1) {
+    estimate.cpi_ci95_ = std::numeric_limits<double>::infinity();
+  } else {
+    double squares = 0.0;
+    for (const auto &sample : estimate.samples_) {
+      const double residual =
+          static_cast<double>(sample.cycles_) -
+          estimate.cpi_ * static_cast<double>(sample.instructions_);
+      squares += residual * residual;
+    }
+    const double stddev = std::sqrt(squares / (n - 1)) / (instructions / n);
+    // finite population correction, the run has num_intervals
+    const double fpc =
+        std::sqrt(1.0 - n / static_cast<double>(num_intervals));
+    estimate.cpi_ci95_ =
+        StudentT95(num_samples - 1) * stddev / std::sqrt(n) * fpc;
+  }
+  estimate.ok_ = true;
+  return estimate;
+}
+
+void PrintSampleEstimate(const SampleEstimate &estimate, std::ostream &os) {
+  os << "sample\tfirst_instruction\tinstructions\tcycles\tcpi\tcpi_ci95\n"
+     << std::fixed << std::setprecision(4);
+  for (size_t i = 0; i < estimate.samples_.size(); ++i) {
+    const SampleResult &sample = estimate.samples_[i];
+    os << i << '\t' << sample.first_ << '\t' << sample.instructions_ << '\t'
+       << sample.cycles_ << '\t'
+       << (sample.instructions_ == 0
+               ? 0.0
+               : static_cast<double>(sample.cycles_) /
+                     static_cast<double>(sample.instructions_))
+       << "\t\n";
+  }
+  const double cycles =
+      estimate.cpi_ * static_cast<double>(estimate.instructions_);
+  os << "estimate\t0\t" << estimate.instructions_ << '\t'
+     << static_cast<size_t>(std::llround(cycles)) << '\t' << estimate.cpi_
+     << '\t' << estimate.cpi_ci95_ << '\n'
+     << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "options.hh"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// How a long run is sampled, see RunSampled()
+class SampleSpec {
+public:
+  int interval_{10000}; // instructions measured per sample
+  int warmup_{10000};   // simulated before each sample but not measured
+  int samples_{30};     // at most, spread evenly over the run
+
+  // Set the parameter called key: interval, warmup or samples. Return false
+  // and fill error if key is unknown or value out of range.
+  bool Set(const std::string &key, int value, std::string &error);
+  // "key=value,key=value,..."
+  bool Parse(const std::string &spec, std::string &error);
+};
+
+// One measured interval of the run
+class SampleResult {
+public:
+  size_t first_{0}; // number of its first instruction in the run
+  size_t instructions_{0};
+  size_t cycles_{0};
+};
+
+// Whole-run estimate from the samples
+class SampleEstimate {
+public:
+  bool ok_{false};
+  std::string error_;
+  size_t instructions_{0}; // of the whole run
+  std::vector<SampleResult> samples_;
+  double cpi_{0.0};
+  // half width of the 95% confidence interval of cpi_, infinite with a
+  // single sample out of several intervals
+  double cpi_ci95_{0.0};
+};
+
+// Estimate the cycles of the trace at path under options without
+// simulating all of it.
+// The run is cut into intervals of spec.interval_ instructions, of which up
+// to spec.samples_ evenly spaced ones are simulated, on num_threads
+// workers, each on a simulator of its own. A functional pass with no timing
+// first finds the pc, registers and memory each sample starts from, and
+// the spec.warmup_ instructions before it are simulated to fill the
+// stations, caches and predictor, then thrown away. The CPI of the run is
+// that of all samples together.
+SampleEstimate RunSampled(const std::string &path, const SampleSpec &spec,
+                          size_t num_threads,
+                          const SimulationOptions &options);
+
+// one row per sample, then the estimate
+void PrintSampleEstimate(const SampleEstimate &estimate, std::ostream &os);
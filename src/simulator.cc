@@ -1,504 +1,854 @@
 #include "simulator.hh"
+#include "checkpoint.hh"
 #include "util.hh"
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <iomanip>
-#include <iostream>
+#include <map>
 #include <memory>
-#include <sstream>
+#include <ostream>
 #include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 std::string InstOpToStr(InstOp instop);
 
 TomasuloSimulator::TomasuloSimulator(
-    std::vector<std::shared_ptr<Instruction>> &&instructions,
-    const int num_load_stations, const int num_add_rsstation,
-    const int num_mul_rsstation)
-    : clocks_(0), raw_stalls_(0), war_stalls_(0),
-      instructions_(std::move(instructions)) {
-  num_left_instructions_ = instructions_.size();
-  for (int i = 1; i <= num_load_stations; ++i) {
-    loadstore_stations_.push_back(std::make_shared<Station>(
-        "Load" + std::to_string(i), StationType::LOAD));
+    std::shared_ptr<InstructionSource> source, const MachineConfig &config)
+    : clocks_(0), raw_stalls_(0), war_stalls_(0), config_(config),
+      source_(std::move(source)),
+      stations_(config.num_load_stations_, config.num_add_stations_,
+                config.num_mult_stations_) {
+  for (int i = 0; i < kNumRegisters; ++i) {
+    registers_[i] = Value::Expr(arena_->Reg(i));
+    register_status_[i] = kNoStation;
   }
-  for (int i = 1; i <= num_add_rsstation; ++i) {
-    reservation_stations_.push_back(
-        std::make_shared<Station>("Add" + std::to_string(i), StationType::ADD));
+  control_.predictor_ = BranchPredictor(config.bht_entries_);
+  memory_timing_ = MemoryTiming(config);
+  units_ = FunctionalUnits(config);
+  control_.committed_registers_ = registers_;
+  Fetch();
+}
+
+// Fetch() keeps the next instruction decoded, so nothing left to issue means
+// the program is done
+bool TomasuloSimulator::IsFinish() const {
+  return !error_.empty() || (window_.empty() && fetch_ == EndSeq());
+}
+
+bool TomasuloSimulator::LoadAll(std::string &error) {
+  // the path through a branch is only known once it resolves
+  while (instructions_.empty() || !IsBranch(instructions_.back().instop_)) {
+    if (!FetchNext())
+      break;
   }
-  for (int i = 1; i <= num_mul_rsstation; ++i) {
-    reservation_stations_.push_back(std::make_shared<Station>(
-        "Mult" + std::to_string(i), StationType::MULT));
+  if (source_ != nullptr && !source_->error_.empty()) {
+    error = source_->error_;
+    return false;
   }
-  for (int i = 0; i <= 30; i += 2) {
-    std::string curr_reg = "F" + std::to_string(i);
-    registers_[curr_reg] = "Regs[" + curr_reg + "]";
-    register_status_[curr_reg] = nullptr;
+  return true;
+}
+
+// loads and operations hand their result to the waiting stations over a
+// common data bus, stores and branches have none
+static bool BroadcastsResult(InstOp instop) {
+  return instop != InstOp::STORE && !IsBranch(instop);
+}
+
+static size_t BranchTarget(const Instruction &inst) {
+  return inst.pc_ + 1 + inst.imm_;
+}
+
+// register an instruction writes, kNoReg for stores and branches
+static RegId DestReg(const Instruction &inst) {
+  if (inst.instop_ == InstOp::LOAD)
+    return inst.rt_;
+  return inst.rd_;
+}
+
+bool TomasuloSimulator::FetchNext() {
+  if (source_ == nullptr || control_.fetch_blocked_)
+    return false;
+  Instruction inst;
+  if (!source_->Decode(control_.pc_, inst)) {
+    // lines are decoded as they are fetched, a bad one stops the run
+    if (error_.empty())
+      error_ = source_->error_;
+    return false;
   }
-  for (int i = 0; i < 32; ++i) {
-    std::string curr_reg = "R" + std::to_string(i);
-    registers_[curr_reg] = "Regs[" + curr_reg + "]";
-    register_status_[curr_reg] = nullptr;
+  control_.pc_ = inst.pc_ + 1;
+  if (IsBranch(inst.instop_)) {
+    if (RobMode()) {
+      inst.predicted_taken_ = control_.predictor_.Predict(inst.pc_);
+      if (inst.predicted_taken_)
+        control_.pc_ = BranchTarget(inst);
+    } else {
+      control_.fetch_blocked_ = true;
+    }
   }
+  instructions_.push_back(inst);
+  return true;
 }
 
-bool TomasuloSimulator::IsFinish() const { return num_left_instructions_ == 0; }
-void TomasuloSimulator::PrintInstructions() const {
-  HelpPrintInstructions(instructions_, clocks_);
+void TomasuloSimulator::Fetch() {
+  if (fetch_ == EndSeq())
+    FetchNext();
+  // it may issue from the next cycle on
+  if (fetch_ < EndSeq() && At(fetch_).ready_time_ == -1)
+    At(fetch_).ready_time_ = static_cast<Cycle>(clocks_) + 1;
 }
-void TomasuloSimulator::PrintLoadAndReservStations() const {
-  HelpPrintLoadAndReservStations(loadstore_stations_, reservation_stations_);
+void TomasuloSimulator::StartAt(size_t pc) {
+  instructions_.clear();
+  first_seq_ = 0;
+  fetch_ = 0;
+  control_.pc_ = pc;
+  control_.fetch_blocked_ = false;
+  Fetch();
 }
-void TomasuloSimulator::PrintRegisterStatus() const {
 
-  HelpPrintRegisterStatus(register_status_);
+TomasuloSimulator::TomasuloSimulator(const SimulatorState &state) {
+  Restore(state);
 }
-void TomasuloSimulator::PrintStatistic() const {
-  HelpPrintStatistic(clocks_, raw_stalls_, war_stalls_);
+
+SimulatorState TomasuloSimulator::Snapshot() const {
+  // instructions and stations refer to each other by tag, so plain copies
+  // need no fixing up; the source is not part of the state, a replay only
+  // goes as far as the instructions already fetched
+  return SimulatorState(clocks_, raw_stalls_, war_stalls_, config_, source_,
+                        instructions_, first_seq_, window_, fetch_, control_,
+                        account_, memory_timing_, units_, stations_,
+                        registers_, memory_, register_status_, arena_,
+                        numeric_, memory_image_);
 }
-void TomasuloSimulator::PrintAllInfo() const {
-  PrintInstructions();
-  PrintLoadAndReservStations();
-  PrintRegisterStatus();
-  PrintStatistic();
+
+void TomasuloSimulator::Restore(const SimulatorState &state) {
+  clocks_ = state.clocks_;
+  raw_stalls_ = state.raw_stalls_;
+  war_stalls_ = state.war_stalls_;
+  config_ = state.config_;
+  step_cycle_ = nullptr;
+  source_ = state.source_;
+  instructions_ = state.instructions_;
+  first_seq_ = state.first_seq_;
+  window_ = state.window_;
+  fetch_ = state.fetch_;
+  control_ = state.control_;
+  account_ = state.account_;
+  memory_timing_ = state.memory_timing_;
+  units_ = state.units_;
+  stations_ = state.stations_;
+  register_status_ = state.register_status_;
+  registers_ = state.registers_;
+  memory_ = state.memory_;
+  arena_ = state.arena_;
+  numeric_ = state.numeric_;
+  memory_image_ = state.memory_image_;
+  history_.Clear();
 }
 
 void TomasuloSimulator::StoreState() {
-  std::vector<std::shared_ptr<Instruction>> cloned_instructions;
-  for (const auto &instr : instructions_) {
-    cloned_instructions.push_back(instr->Clone());
-  }
-  std::vector<std::shared_ptr<Station>> cloned_loadstore_stations;
-  for (const auto &station : loadstore_stations_) {
-    cloned_loadstore_stations.push_back(station->Clone());
-  }
-  std::vector<std::shared_ptr<Station>> cloned_reservation_stations;
-  for (const auto &station : reservation_stations_) {
-    cloned_reservation_stations.push_back(station->Clone());
-  }
-  std::unordered_map<std::string, std::shared_ptr<Station>>
-      cloned_register_status;
-  for (const auto &[key, station] : register_status_) {
-    cloned_register_status[key] = station ? station->Clone() : nullptr;
-  }
-  states_.emplace_back(clocks_, raw_stalls_, war_stalls_,
-                       num_left_instructions_, cloned_instructions,
-                       cloned_loadstore_stations, cloned_reservation_stations,
-                       registers_, memory_, cloned_register_status);
-}
-
-void TomasuloSimulator::Run() {
-  PrintInstructions();
-  PrintLoadAndReservStations();
-  PrintRegisterStatus();
-  HelpPrintUsage();
-  bool is_terminated = false;
-  while (!is_terminated) {
-    std::cout << "Please input your command: ";
-    std::string cmd;
-    getline(std::cin, cmd);
-    std::istringstream iss(cmd);
-    char cmd_type;
-    iss >> cmd_type;
-    switch (cmd_type) {
-    case 'v':
-      char view_type;
-      if (!(iss >> view_type)) {
-        HelpPrintUsage();
-        break;
-      }
-      switch (view_type) {
-      case 'i':
-        PrintInstructions();
-        break;
-      case 'l':
-        PrintLoadAndReservStations();
-        break;
-      case 'r':
-        PrintRegisterStatus();
-        break;
-      case 's':
-        PrintStatistic();
-        break;
-      case 'a':
-        PrintAllInfo();
-        break;
-      default:
-        HelpPrintUsage();
-        break;
-      }
-      break;
-    case 's':
-      int steps;
-      if (!(iss >> steps)) {
-        Step();
-      } else {
-        Step(steps);
-      }
-      // PrintAllInfo();
-      break;
-    case 'r':
-      RunToEnd();
-      break;
-    case 'b':
-      int backs;
-      if (!(iss >> backs)) {
-        Backtrace();
-      } else {
-        Backtrace(backs);
-      }
-      break;
-    case 'q':
-      std::cout << "Bye Bye\n";
-      is_terminated = true;
-      break;
-    default:
-      HelpPrintUsage();
-      break;
+  if (history_.NeedCheckpoint(clocks_)) {
+    HostScope snapshot(host_profile_, HostPhase::SNAPSHOT);
+    history_.AddCheckpoint(Snapshot());
+  }
+}
+
+void TomasuloSimulator::EnableNumericMode(
+    const RegisterImage &registers,
+    std::shared_ptr<const MappedFile> memory_image) {
+  numeric_ = true;
+  for (int i = 0; i < kNumRegisters; ++i) {
+    registers_[i] = Value::Num(registers[i]);
+  }
+  control_.committed_registers_ = registers_;
+  memory_.clear();
+  memory_image_.image_ = std::move(memory_image);
+  memory_image_.stores_.clear();
+}
+
+Value TomasuloSimulator::MakeImm(int imm) {
+  return numeric_ ? Value::Num(imm) : Value::Expr(arena_->Imm(imm));
+}
+
+Value TomasuloSimulator::Compute(ExprKind kind, const Value &lhs,
+                                 const Value &rhs) {
+  if (!numeric_)
+    return Value::Expr(arena_->Binary(kind, lhs.expr_, rhs.expr_));
+  switch (kind) {
+  case ExprKind::ADD:
+    return Value::Num(lhs.num_ + rhs.num_);
+  case ExprKind::SUB:
+    return Value::Num(lhs.num_ - rhs.num_);
+  case ExprKind::MUL:
+    return Value::Num(lhs.num_ * rhs.num_);
+  case ExprKind::DIV:
+    return Value::Num(lhs.num_ / rhs.num_);
+  default:
+    return Value();
+  }
+}
+
+static uint64_t ToAddress(const Value &address) {
+  return static_cast<uint64_t>(static_cast<int64_t>(address.num_));
+}
+
+uint64_t TomasuloSimulator::AddressKey(const Value &address) const {
+  return numeric_ ? ToAddress(address) : address.expr_;
+}
+
+Value TomasuloSimulator::ReadMemory(const Value &address) {
+  if (!numeric_)
+    return Value::Expr(arena_->Mem(address.expr_));
+  return Value::Num(memory_image_.Read(ToAddress(address)));
+}
+
+void TomasuloSimulator::WriteMemory(const Value &address, const Value &value) {
+  if (!numeric_) {
+    memory_[address.expr_] = value;
+    return;
+  }
+  memory_image_.Write(ToAddress(address), value.num_);
+}
+
+void TomasuloSimulator::DumpArchState(std::ostream &os) const {
+  for (int i = 0; i < kNumRegisters; ++i) {
+    os << RegName(i) << ' ';
+    if (numeric_) {
+      os << std::setprecision(17) << registers_[i].num_ << '\n';
+    } else {
+      os << arena_->ToString(registers_[i]) << '\n';
+    }
+  }
+  if (numeric_) {
+    // by address
+    std::vector<std::pair<uint64_t, double>> stores(
+        memory_image_.stores_.begin(), memory_image_.stores_.end());
+    std::sort(stores.begin(), stores.end());
+    for (const auto &[address, value] : stores) {
+      os << "Mem[" << address << "] " << std::setprecision(17) << value
+         << '\n';
     }
+    return;
+  }
+  std::map<std::string, std::string> memory;
+  for (const auto &[address, value] : memory_) {
+    memory[arena_->ToString(address)] = arena_->ToString(value);
   }
+  for (const auto &[address, value] : memory) {
+    os << "Mem[" << address << "] " << value << '\n';
+  }
+}
+
+// shapes with a specialized core, the textbook machine first
+using FixedShapes =
+    std::tuple<FixedShape<3, 3, 2, 2, 2, 10, 40>,
+               FixedShape<4, 4, 3, 2, 2, 10, 40>,
+               FixedShape<8, 8, 4, 2, 2, 10, 40>>;
+
+template <class... Shapes>
+static void (TomasuloSimulator::*PickCore(const MachineConfig &config,
+                                          std::tuple<Shapes...> *))() {
+  void (TomasuloSimulator::*step_cycle)() =
+      &TomasuloSimulator::StepCycle<RuntimeShape>;
+  (void)((Shapes::Matches(config) &&
+          (step_cycle = &TomasuloSimulator::StepCycle<Shapes>, true)) ||
+         ...);
+  return step_cycle;
+}
+
+void TomasuloSimulator::SelectCore() {
+  step_cycle_ = specialized_core_
+                    ? PickCore(config_, static_cast<FixedShapes *>(nullptr))
+                    : &TomasuloSimulator::StepCycle<RuntimeShape>;
 }
+
 void TomasuloSimulator::SingleStep() {
-  if (IsFinish()) {
-    std::cerr << "!!!All the instructions has been executed compeletely!!!\n";
+  if (IsFinish())
     return;
-  }
+  if (step_cycle_ == nullptr)
+    SelectCore();
+  (this->*step_cycle_)();
+}
+
+template <class Shape> void TomasuloSimulator::StepCycle() {
+  if (record_history_ && clocks_ == 0)
+    StoreState(); // the initial state to replay from
   ++clocks_;
-  for (auto &inst : instructions_) {
-    if (inst->write_time_ != -1) // writeback finished
+  if (RobMode()) {
+    HostScope commit(host_profile_, HostPhase::COMMIT);
+    Commit();
+  }
+  // only the instructions in flight; the written back ones are skipped and
+  // leave the window below, or on commit with a reorder buffer
+  size_t mispredicted = SIZE_MAX;
+  // common data buses left this cycle, handed out oldest first
+  size_t free_buses = config_.num_cdbs_ == 0
+                          ? SIZE_MAX
+                          : static_cast<size_t>(config_.num_cdbs_);
+  HostScope execute(host_profile_, HostPhase::EXECUTE);
+  for (size_t seq : window_) {
+    Instruction &inst = At(seq);
+    if (inst.write_time_ != -1) // writeback finished
       continue;
+    const StationTag tag = inst.station_;
+    const size_t station = StationFile::Index(tag);
     // writeback not finished
-    if (inst->exec_end_time_ != -1) { // execution finished
-      switch (inst->instop_) {
+    if (inst.exec_end_time_ != -1) { // execution finished
+      HostScope writeback(host_profile_, HostPhase::WRITEBACK);
+      if (BroadcastsResult(inst.instop_)) {
+        if (free_buses == 0) // waits for a common data bus
+          continue;
+        --free_buses;
+      }
+      switch (inst.instop_) {
       case InstOp::LOAD:
-        if (register_status_[inst->rt_] == inst->station_) {
-          registers_[inst->rt_] = inst->result_;
-          register_status_[inst->rt_] = nullptr;
+        if (register_status_[inst.rt_] == tag) {
+          registers_[inst.rt_] = inst.result_;
+          register_status_[inst.rt_] = kNoStation;
         }
+        [[fallthrough]];
       case InstOp::ADDD:
       case InstOp::SUBD:
       case InstOp::MULD:
-      case InstOp::DIVD: {
-        inst->write_time_ = clocks_;
-        for (auto &load_station : loadstore_stations_) {
-          if (load_station->Qj_ == inst->station_) {
-            load_station->Vj_ = inst->result_;
-            load_station->Qj_ = nullptr;
-          }
-          if (load_station->Qk_ == inst->station_) {
-            load_station->Vk_ = inst->result_;
-            load_station->Qk_ = nullptr;
-          }
-        }
-        for (auto &reserv_station : reservation_stations_) {
-          if (reserv_station->Qj_ == inst->station_) {
-            reserv_station->Vj_ = inst->result_;
-            reserv_station->Qj_ = nullptr;
-            if (reserv_station->Qk_ == nullptr) {
-              reserv_station->time_ = 0;
-            }
-          }
-          if (reserv_station->Qk_ == inst->station_) {
-            reserv_station->Vk_ = inst->result_;
-            reserv_station->Qk_ = nullptr;
-            if (reserv_station->Qj_ == nullptr) {
-              reserv_station->time_ = 0;
-            }
-          }
+      case InstOp::DIVD:
+      case InstOp::DADDI: {
+        inst.write_time_ = clocks_;
+        if (observer_ != nullptr)
+          observer_->OnWriteback(seq, inst);
+        stations_.Broadcast<Shape::kNumStations>(tag, inst.result_,
+                                                 inst.instop_);
+        if (inst.instop_ != InstOp::LOAD &&
+            register_status_[inst.rd_] == tag) {
+          registers_[inst.rd_] = inst.result_;
+          register_status_[inst.rd_] = kNoStation;
         }
-        if (inst->instop_ != InstOp::LOAD &&
-            register_status_[inst->rd_or_imm_] == inst->station_) {
-          registers_[inst->rd_or_imm_] = inst->result_;
-          register_status_[inst->rd_or_imm_] = nullptr;
-        }
-        inst->station_->ResetEmpty();
-        --num_left_instructions_;
+        stations_.ResetEmpty(station);
+        if (!RobMode())
+          Retire(seq);
       } break;
+      case InstOp::BEQ:
+      case InstOp::BNE:
+        inst.write_time_ = clocks_;
+        if (observer_ != nullptr)
+          observer_->OnWriteback(seq, inst);
+        stations_.ResetEmpty(station);
+        if (!RobMode())
+          Retire(seq);
+        if (ResolveBranch(inst))
+          mispredicted = seq;
+        break;
       case InstOp::STORE:
-        if (inst->station_->Qk_ == nullptr) {
-          memory_[inst->result_] = inst->station_->Vk_;
-          inst->station_->ResetEmpty();
-          inst->write_time_ = clocks_;
-          --num_left_instructions_;
+        if (stations_.Qk_[station] == kNoStation &&
+            (RobMode() || StoreMayWrite(seq))) {
+          inst.write_time_ = clocks_;
+          if (observer_ != nullptr)
+            observer_->OnWriteback(seq, inst);
+          if (!RobMode()) { // else memory is written on commit
+            WriteMemory(stations_.Address_[station], stations_.Vk_[station]);
+            if (memory_timing_.Enabled())
+              memory_timing_.Store(AddressKey(stations_.Address_[station]),
+                                   !numeric_);
+            stations_.ResetEmpty(station);
+            Retire(seq);
+          }
         }
         break;
       case InstOp::NONE:
         break;
       }
     } else {                              // execution not finished
-      if (inst->exec_begin_time_ != -1) { // execution started
-        --inst->station_->time_;
-        if (inst->station_->time_ == 0) {
-          inst->exec_end_time_ = clocks_; // execution now just finished
-          switch (inst->instop_) {
-          case InstOp::LOAD:
-          case InstOp::STORE:
-            inst->result_ = "Mem[" + inst->station_->Address_ + "]";
-            break;
-          case InstOp::ADDD:
-            inst->result_ = inst->station_->Vj_ + "+" + inst->station_->Vk_;
-            break;
-          case InstOp::SUBD:
-            inst->result_ = inst->station_->Vj_ + "-" + inst->station_->Vk_;
-            break;
-          case InstOp::MULD:
-            inst->result_ = inst->station_->Vj_ + "*" + inst->station_->Vk_;
-            break;
-          case InstOp::DIVD:
-            inst->result_ = inst->station_->Vj_ + "/" + inst->station_->Vk_;
-            break;
-          case InstOp::NONE:
-            break;
-          }
-        }
+      if (inst.exec_begin_time_ != -1) { // execution started
+        if (--stations_.time_[station] == 0)
+          FinishExecution(seq, station); // execution now just finished
       } else {                         // execution not start
-        if (inst->issue_time_ != -1) { // has issued
-          // allow to execute
-          if (inst->station_->Qj_ == nullptr &&
-              inst->station_->Qk_ == nullptr) {
-            inst->exec_begin_time_ = clocks_ - ~inst->station_->time_;
-            switch (inst->instop_) {
-            case InstOp::LOAD:
-            case InstOp::STORE: {
-              inst->station_->Address_ =
-                  inst->station_->Address_ + "+" + registers_[inst->rs_];
-              inst->station_->time_ += loadstore_latency_;
-            } break;
-            case InstOp::ADDD:
-            case InstOp::SUBD:
-              inst->station_->time_ += adddsubd_latency_;
-              break;
-            case InstOp::MULD:
-              inst->station_->time_ += multd_latency_;
-              break;
-            case InstOp::DIVD:
-              inst->station_->time_ += divd_latency_;
-              break;
-            case InstOp::NONE:
-              break;
-            }
-          }
-        } else { // not issue, try issue
-          switch (inst->instop_) {
-          case InstOp::LOAD:
-          case InstOp::STORE: {
-            for (auto &load_station : loadstore_stations_) {
-              if (load_station->busy_)
-                continue;
-              inst->issue_time_ = clocks_;
-              inst->station_ = load_station;
-              if (register_status_[inst->rs_] == nullptr) {
-                load_station->Vj_ = registers_[inst->rs_];
-                load_station->Qj_ = nullptr;
-              } else {
-                load_station->Vj_.clear();
-                load_station->Qj_ = register_status_[inst->rs_];
-              }
-              load_station->busy_ = true;
-              load_station->instop_ = inst->instop_;
-              load_station->Address_ = inst->rd_or_imm_;
-              if (inst->instop_ == InstOp::LOAD) {
-                register_status_[inst->rt_] = load_station;
-              } else { // Store
-                if (register_status_[inst->rt_] == nullptr) {
-                  load_station->Vk_ = registers_[inst->rt_];
-                  load_station->Qk_ = nullptr;
-                } else {
-                  load_station->Vk_.clear();
-                  load_station->Qk_ = register_status_[inst->rt_];
-                }
-              }
-              break;
-            }
-          } break;
-          case InstOp::ADDD:
-          case InstOp::SUBD:
-          case InstOp::MULD:
-          case InstOp::DIVD: {
-            for (auto &reservstation : reservation_stations_) {
-              if (reservstation->busy_ == true ||
-                  (reservstation->station_type_ == StationType::ADD &&
-                   inst->instop_ != InstOp::ADDD &&
-                   inst->instop_ != InstOp::SUBD) ||
-                  ((reservstation->station_type_ == StationType::MULT &&
-                    inst->instop_ != InstOp::MULD &&
-                    inst->instop_ != InstOp::DIVD)))
-                continue;
-              inst->issue_time_ = clocks_;
-              inst->station_ = reservstation;
-              if (register_status_[inst->rs_] == nullptr) {
-                reservstation->Vj_ = registers_[inst->rs_];
-                reservstation->Qj_ = nullptr;
-              } else {
-                reservstation->Vj_.clear();
-                reservstation->Qj_ = register_status_[inst->rs_];
-              }
-              if (register_status_[inst->rt_] == nullptr) {
-                reservstation->Vk_ = registers_[inst->rt_];
-                reservstation->Qk_ = nullptr;
-              } else {
-                reservstation->Vk_.clear();
-                reservstation->Qk_ = register_status_[inst->rt_];
-              }
-              reservstation->busy_ = true;
-              reservstation->instop_ = inst->instop_;
-              register_status_[inst->rd_or_imm_] = reservstation;
-              break;
-            }
-            break;
-          }
-          case InstOp::NONE: {
-            std::cerr << "Something wrong with instruction issue!\n";
-            abort();
-          } break;
-          }
-          break;
-        }
+        if (inst.issue_time_ != -1 && // has issued
+            stations_.Qj_[station] == kNoStation &&
+            stations_.Qk_[station] == kNoStation) // allow to execute
+          BeginExecution<Shape>(seq);
       }
     }
+    if (mispredicted != SIZE_MAX) // the rest is on the wrong path
+      break;
+  }
+  execute.End();
+  if (mispredicted != SIZE_MAX) {
+    Squash(mispredicted);
+  } else if (!RobMode()) {
+    window_.erase(std::remove_if(window_.begin(), window_.end(),
+                                 [this](size_t seq) {
+                                   return At(seq).write_time_ != -1;
+                                 }),
+                  window_.end());
   }
-  StoreState();
-  if (IsFinish()) {
-    std::cout << "!!!All the instructions are executed compeletely!!!\n";
+  const size_t oldest = window_.empty() ? fetch_ : window_.front();
+  const size_t keep = retain_instructions_ ? max_retained_ : 0;
+  while (oldest - first_seq_ > keep) {
+    instructions_.pop_front();
+    ++first_seq_;
   }
+  // in-order issue, up to issue_width_ instructions per cycle
+  HostScope issue(host_profile_, HostPhase::ISSUE);
+  for (int issued = 0; issued < config_.issue_width_ && fetch_ < EndSeq();
+       ++issued) {
+    Instruction &inst = At(fetch_);
+    if (issued != 0) // it was behind one issued this cycle
+      inst.ready_time_ = static_cast<Cycle>(clocks_);
+    if (!HasRobEntry() || !TryIssue<Shape>(inst))
+      break;
+    if (observer_ != nullptr)
+      observer_->OnIssue(fetch_, inst);
+    window_.push_back(fetch_++);
+    Fetch();
+  }
+  Fetch();
+  issue.End();
+  AccountCycles(1);
+  if (record_history_)
+    StoreState();
 }
-void TomasuloSimulator::Step(size_t cycles) {
-  if (IsFinish()) {
-    std::cerr << "!!!All the instructions has been executed!!!\n";
-    return;
+template <class Shape> void TomasuloSimulator::BeginExecution(size_t seq) {
+  Instruction &inst = At(seq);
+  const size_t station = StationFile::Index(inst.station_);
+  int &time = stations_.time_[station];
+  const bool memory_access =
+      inst.instop_ == InstOp::LOAD || inst.instop_ == InstOp::STORE;
+  Value address;
+  size_t forward = SIZE_MAX;
+  if (memory_access) {
+    address = Compute(ExprKind::ADD, stations_.Address_[station],
+                      stations_.Vj_[station]);
+    if (inst.instop_ == InstOp::LOAD) {
+      inst.order_blocked_ = !OrderLoad(seq, address, forward);
+      if (inst.order_blocked_)
+        return;
+    }
   }
-  for (size_t i = 0; i < cycles && !IsFinish(); ++i) {
-    SingleStep();
+  const UnitType unit = UnitOf(inst.instop_);
+  if (units_.Limited(unit)) {
+    const size_t begin = clocks_ - ~time;
+    if (!units_.Claim(unit, begin)) {
+      if (inst.unit_wait_time_ == -1)
+        inst.unit_wait_time_ = static_cast<Cycle>(begin);
+      time = -1; // starts in the cycle it gets one
+      return;
+    }
   }
-  PrintAllInfo();
+  int latency = Latency<Shape>(inst.instop_);
+  if (memory_access) {
+    if (inst.instop_ == InstOp::LOAD) {
+      if (forward != SIZE_MAX) { // no need to go to memory
+        const size_t store = StationFile::Index(At(forward).station_);
+        inst.result_ = stations_.Vk_[store];
+        inst.forwarded_ = true;
+        ++memory_timing_.forwarded_;
+        if (memory_timing_.Enabled())
+          latency = config_.l1_latency_;
+      } else if (memory_timing_.Enabled()) {
+        latency = memory_timing_.Load(AddressKey(address), !numeric_, config_);
+      }
+    } else if (memory_timing_.Enabled()) { // the store buffer takes it
+      latency = config_.l1_latency_;
+    }
+    stations_.Address_[station] = address;
+  }
+  inst.exec_begin_time_ = clocks_ - ~time;
+  inst.raw_producer_ = stations_.waited_on_[station];
+  if (observer_ != nullptr)
+    observer_->OnDispatch(seq, inst);
+  time += latency;
+  if (time == 0) // single-cycle
+    FinishExecution(seq, station);
 }
-void TomasuloSimulator::RunToEnd() {
-  if (IsFinish()) {
-    std::cerr << "!!!All the instructions has been executed!!!\n";
-    return;
+
+void TomasuloSimulator::FinishExecution(size_t seq, size_t station) {
+  Instruction &inst = At(seq);
+  inst.exec_end_time_ = clocks_;
+  const Value &Vj = stations_.Vj_[station];
+  const Value &Vk = stations_.Vk_[station];
+  switch (inst.instop_) {
+  case InstOp::LOAD:
+    // a symbolic load reads Mem[address] whether forwarded or not
+    if (!inst.forwarded_ || !numeric_)
+      inst.result_ = ReadMemory(stations_.Address_[station]);
+    break;
+  case InstOp::STORE: // writes memory on writeback
+    break;
+  case InstOp::ADDD:
+  case InstOp::DADDI:
+    inst.result_ = Compute(ExprKind::ADD, Vj, Vk);
+    break;
+  case InstOp::SUBD:
+    inst.result_ = Compute(ExprKind::SUB, Vj, Vk);
+    break;
+  case InstOp::MULD:
+    inst.result_ = Compute(ExprKind::MUL, Vj, Vk);
+    break;
+  case InstOp::DIVD:
+    inst.result_ = Compute(ExprKind::DIV, Vj, Vk);
+    break;
+  case InstOp::BEQ:
+  case InstOp::BNE:
+    if (!numeric_)
+      error_ = "Branches need numeric mode (-n): " + std::string(inst.text_);
+    inst.result_ =
+        Value::Num((Vj.num_ == Vk.num_) == (inst.instop_ == InstOp::BEQ));
+    break;
+  case InstOp::NONE:
+    break;
   }
-  while (!IsFinish()) {
-    SingleStep();
+  if (observer_ != nullptr)
+    observer_->OnComplete(seq, inst);
+}
+
+bool TomasuloSimulator::ResolveBranch(const Instruction &inst) {
+  const bool taken = inst.result_.num_ != 0;
+  ++control_.branches_;
+  if (!RobMode()) { // fetch waited for this one
+    control_.branch_penalty_ += clocks_ - inst.issue_time_;
+    control_.fetch_blocked_ = false;
+    control_.pc_ = taken ? BranchTarget(inst) : inst.pc_ + 1;
+    return false;
   }
-  PrintAllInfo();
+  control_.predictor_.Update(inst.pc_, taken);
+  if (taken == inst.predicted_taken_)
+    return false;
+  ++control_.mispredicts_;
+  control_.branch_penalty_ += clocks_ - inst.issue_time_;
+  control_.pc_ = taken ? BranchTarget(inst) : inst.pc_ + 1;
+  return true;
 }
-void TomasuloSimulator::Backtrace(size_t cycles) {
-  if (cycles >= clocks_ || cycles <= 0) {
-    std::cerr << "Please input a cycle clocks greater than 0 and less than "
-              << clocks_ << '\n';
-    return;
+
+void TomasuloSimulator::Squash(size_t branch_seq) {
+  auto first_squashed =
+      std::upper_bound(window_.begin(), window_.end(), branch_seq);
+  for (auto it = first_squashed; it != window_.end(); ++it) {
+    // a freed station can only have gone to a younger, squashed one
+    const size_t station = StationFile::Index(At(*it).station_);
+    if (stations_.busy_[station])
+      stations_.ResetEmpty(station);
   }
-  const auto &back_state = states_[cycles - 1];
-  std::cout << "!!!Backtrace to cycle " << cycles << "!!!\n";
-  back_state.PrintAllInfo();
-}
-void TomasuloSimulator::HelpPrintUsage() {
-  std::cout
-      << "Usage: \n"
-      << "v [i | l | r | s | a] : "
-         "display instructions status | load and reservation stations | "
-         "registers result status | statistics | all information aforesaid\n"
-      << "s [n(optional)] : step 1/n cycle(s)\n"
-      << "r : run to the end\n"
-      << "b [n] : look back the info of the simulator at the nth clock cycle\n"
-      << "q : quit the simulator\n";
-}
-void TomasuloSimulator::HelpPrintInstructions(
-    const std::vector<std::shared_ptr<Instruction>> &instructions,
-    const size_t clocks) {
-  std::cout << "Instruction Status\n";
-  std::cout << "Instruction\t\tIssue\tExec\tWrite\n";
-  for (auto &inst : instructions) {
-    std::cout << inst->text_ << '\t';
-    if (inst->issue_time_ != -1)
-      std::cout << inst->issue_time_;
-    std::cout << '\t';
-    if (inst->exec_begin_time_ != -1 &&
-        inst->exec_begin_time_ <= static_cast<int>(clocks)) {
-      std::cout << inst->exec_begin_time_ << "~";
-      if (inst->exec_end_time_ != -1)
-        std::cout << inst->exec_end_time_;
+  window_.erase(first_squashed, window_.end());
+  control_.flushed_ += EndSeq() - (branch_seq + 1);
+  instructions_.resize(branch_seq + 1 - first_seq_);
+  fetch_ = branch_seq + 1;
+  // rename state of the older instructions, on top of the committed one
+  registers_ = control_.committed_registers_;
+  register_status_.fill(kNoStation);
+  for (size_t seq : window_) {
+    const Instruction &inst = At(seq);
+    const RegId reg = DestReg(inst);
+    if (reg == kNoReg)
+      continue;
+    if (inst.write_time_ != -1) {
+      registers_[reg] = inst.result_;
+      register_status_[reg] = kNoStation;
+    } else {
+      register_status_[reg] = inst.station_;
     }
-    std::cout << '\t';
-    if (inst->write_time_ != -1)
-      std::cout << inst->write_time_;
-    std::cout << "\t\n";
-  }
-}
-void TomasuloSimulator::HelpPrintLoadAndReservStations(
-    const std::vector<std::shared_ptr<Station>> &loadstore_stations,
-    const std::vector<std::shared_ptr<Station>> &reservation_stations) {
-  std::cout << "Load Stations\n";
-  std::cout << "Name\t\tBusy\tAddress\t\n";
-  for (auto &load_station : loadstore_stations) {
-    std::cout << load_station->name_ << "\t\t" << load_station->busy_ << '\t'
-              << load_station->Address_ << "\t\n";
-  }
-
-  std::cout << "Reservation Stations\n";
-  std::cout << std::left << "Time" << '\t' << "Name"
-            << "\t\t"
-            << "Busy\tOp\t" << std::setw(32) << "Vj" << '\t' << std::setw(32)
-            << "Vk"
-            << "\tQj\tQk\t\n";
-  for (auto &reserv_station : reservation_stations) {
-    HelpPrintReservStation(reserv_station);
-  }
-}
-void TomasuloSimulator::HelpPrintReservStation(
-    const std::shared_ptr<Station> &reserv_station) {
-  if (reserv_station->time_ != -1) {
-    std::cout << std::left << reserv_station->time_;
-  }
-  std::cout << std::left << '\t' << reserv_station->name_ << "\t\t"
-            << reserv_station->busy_ << '\t';
-  if (reserv_station->busy_ == false) {
-    std::cout << "\t\n";
-    return;
   }
-  std::cout << std::left << InstOpToStr(reserv_station->instop_) << '\t'
-            << std::setw(32) << reserv_station->Vj_ << '\t' << std::setw(32)
-            << reserv_station->Vk_ << '\t';
-  if (reserv_station->Qj_ != nullptr) {
-    std::cout << reserv_station->Qj_->name_;
-  }
-  std::cout << '\t';
-  if (reserv_station->Qk_ != nullptr) {
-    std::cout << reserv_station->Qk_->name_;
-  }
-  std::cout << "\t\n";
-}
-void TomasuloSimulator::HelpPrintRegisterStatus(
-    const std::unordered_map<std::string, std::shared_ptr<Station>>
-        &register_status) {
-  std::cout << "Register Result Status\n";
-  std::cout << "Reg\t";
-  for (int i = 0; i <= 30; i += 2) {
-    std::cout << "F" << i << '\t';
-  }
-  std::cout << '\n';
-  std::cout << "FU\t";
-  for (int i = 0; i <= 30; i += 2) {
-    std::string fu = "F" + std::to_string(i);
-    auto &reg_status = register_status.at(fu);
-    if (reg_status != nullptr) {
-      std::cout << reg_status->name_;
+}
+
+void TomasuloSimulator::Commit() {
+  size_t num_committed = 0;
+  while (num_committed < window_.size() &&
+         num_committed < static_cast<size_t>(config_.commit_width_)) {
+    const size_t seq = window_[num_committed];
+    Instruction &inst = At(seq);
+    if (inst.write_time_ == -1)
+      break;
+    inst.commit_time_ = clocks_;
+    if (observer_ != nullptr)
+      observer_->OnCommit(seq, inst);
+    if (inst.instop_ == InstOp::STORE) {
+      const size_t station = StationFile::Index(inst.station_);
+      WriteMemory(stations_.Address_[station], stations_.Vk_[station]);
+      if (memory_timing_.Enabled())
+        memory_timing_.Store(AddressKey(stations_.Address_[station]),
+                             !numeric_);
+      stations_.ResetEmpty(station);
+    }
+    const RegId reg = DestReg(inst);
+    if (reg != kNoReg)
+      control_.committed_registers_[reg] = inst.result_;
+    Retire(seq);
+    ++num_committed;
+  }
+  control_.committed_ += num_committed;
+  window_.erase(window_.begin(), window_.begin() + num_committed);
+}
+
+bool TomasuloSimulator::OrderLoad(size_t seq, const Value &address,
+                                  size_t &forward) const {
+  const uint64_t key = AddressKey(address);
+  forward = SIZE_MAX;
+  for (size_t older : window_) {
+    if (older == seq)
+      break;
+    const Instruction &store = At(older);
+    // with a reorder buffer memory is written on commit
+    if (store.instop_ != InstOp::STORE ||
+        (!RobMode() && store.write_time_ != -1))
+      continue;
+    if (store.exec_begin_time_ == -1) // address unknown
+      return false;
+    const size_t station = StationFile::Index(store.station_);
+    if (AddressKey(stations_.Address_[station]) == key)
+      forward = older;
+  }
+  return forward == SIZE_MAX ||
+         stations_.Qk_[StationFile::Index(At(forward).station_)] ==
+             kNoStation;
+}
+
+bool TomasuloSimulator::StoreMayWrite(size_t seq) const {
+  const uint64_t key =
+      AddressKey(stations_.Address_[StationFile::Index(At(seq).station_)]);
+  for (size_t older : window_) {
+    if (older == seq)
+      break;
+    const Instruction &inst = At(older);
+    // an older store still to write, or load still to read
+    const bool pending =
+        (inst.instop_ == InstOp::STORE && inst.write_time_ == -1) ||
+        (inst.instop_ == InstOp::LOAD && inst.exec_end_time_ == -1 &&
+         !inst.forwarded_);
+    if (!pending)
+      continue;
+    if (inst.exec_begin_time_ == -1) // address unknown
+      return false;
+    const size_t station = StationFile::Index(inst.station_);
+    if (AddressKey(stations_.Address_[station]) == key)
+      return false;
+  }
+  return true;
+}
+
+bool TomasuloSimulator::HasRobEntry() const {
+  return !RobMode() ||
+         window_.size() < static_cast<size_t>(config_.rob_entries_);
+}
+
+template <class Shape> int TomasuloSimulator::Latency(InstOp instop) const {
+  switch (instop) {
+  case InstOp::LOAD:
+  case InstOp::STORE:
+    return Shape::kFixed ? Shape::kLoadStoreLatency
+                         : config_.loadstore_latency_;
+  case InstOp::ADDD:
+  case InstOp::SUBD:
+    return Shape::kFixed ? Shape::kAddSubLatency : config_.adddsubd_latency_;
+  case InstOp::MULD:
+    return Shape::kFixed ? Shape::kMultDLatency : config_.multd_latency_;
+  case InstOp::DIVD:
+    return Shape::kFixed ? Shape::kDivDLatency : config_.divd_latency_;
+  case InstOp::DADDI:
+  case InstOp::BEQ:
+  case InstOp::BNE:
+    return config_.int_latency_;
+  case InstOp::NONE:
+    break;
+  }
+  return 0;
+}
+template <class Shape> bool TomasuloSimulator::TryIssue(Instruction &inst) {
+  if (inst.instop_ == InstOp::NONE) {
+    std::fputs("Something wrong with instruction issue!\n", stderr);
+    std::abort();
+  }
+  const StationTag tag = FindFreeStation<Shape>(inst);
+  if (tag == kNoStation)
+    return false;
+  const size_t station = StationFile::Index(tag);
+  inst.issue_time_ = clocks_;
+  inst.station_ = tag;
+  ReadOperand(inst.rs_, stations_.Vj_[station], stations_.Qj_[station]);
+  stations_.busy_[station] = true;
+  stations_.instop_[station] = inst.instop_;
+  switch (inst.instop_) {
+  case InstOp::LOAD:
+    stations_.Address_[station] = MakeImm(inst.imm_);
+    register_status_[inst.rt_] = tag;
+    break;
+  case InstOp::STORE:
+    stations_.Address_[station] = MakeImm(inst.imm_);
+    ReadOperand(inst.rt_, stations_.Vk_[station], stations_.Qk_[station]);
+    break;
+  case InstOp::DADDI:
+    stations_.Vk_[station] = MakeImm(inst.imm_);
+    stations_.Qk_[station] = kNoStation;
+    register_status_[inst.rd_] = tag;
+    break;
+  case InstOp::BEQ:
+  case InstOp::BNE:
+    ReadOperand(inst.rt_, stations_.Vk_[station], stations_.Qk_[station]);
+    break;
+  default:
+    ReadOperand(inst.rt_, stations_.Vk_[station], stations_.Qk_[station]);
+    register_status_[inst.rd_] = tag;
+    break;
+  }
+  return true;
+}
+void TomasuloSimulator::Retire(size_t seq) {
+  retired_in_cycle_ = true;
+  raw_stalls_ += account_.AddRetired(At(seq));
+  if (retire_sink_)
+    retire_sink_(seq, At(seq));
+  if (pipeline_trace_ != nullptr) {
+    HostScope trace(host_profile_, HostPhase::TRACE);
+    pipeline_trace_->Add(seq, At(seq));
+  }
+}
+void TomasuloSimulator::ReadOperand(RegId reg, Value &V, StationTag &Q) const {
+  if (register_status_[reg] == kNoStation) {
+    V = registers_[reg];
+    Q = kNoStation;
+  } else {
+    V = Value();
+    Q = register_status_[reg];
+  }
+}
+template <class Shape>
+StationTag TomasuloSimulator::FindFreeStation(const Instruction &inst) const {
+  const size_t num_load_stations = Shape::kFixed
+                                       ? Shape::kNumLoadStations
+                                       : stations_.num_load_stations_;
+  const size_t num_stations =
+      Shape::kFixed ? Shape::kNumStations : stations_.Size();
+  const bool is_loadstore =
+      inst.instop_ == InstOp::LOAD || inst.instop_ == InstOp::STORE;
+  const size_t begin = is_loadstore ? 0 : num_load_stations;
+  const size_t end = is_loadstore ? num_load_stations : num_stations;
+  for (size_t i = begin; i < end; ++i) {
+    if (!stations_.busy_[i] && CanIssueTo(inst, stations_.station_type_[i]))
+      return StationFile::Tag(i);
+  }
+  return kNoStation;
+}
+bool TomasuloSimulator::CanIssueTo(const Instruction &inst,
+                                   StationType station_type) {
+  switch (station_type) {
+  case StationType::LOAD:
+    return inst.instop_ == InstOp::LOAD || inst.instop_ == InstOp::STORE;
+  case StationType::ADD:
+    // the integer ALU and branches share the adders
+    return inst.instop_ == InstOp::ADDD || inst.instop_ == InstOp::SUBD ||
+           inst.instop_ == InstOp::DADDI || IsBranch(inst.instop_);
+  case StationType::MULT:
+    return inst.instop_ == InstOp::MULD || inst.instop_ == InstOp::DIVD;
+  }
+  return false;
+}
+
+size_t TomasuloSimulator::QuietCycles() const {
+  size_t quiet = SIZE_MAX;
+  for (size_t seq : window_) {
+    const Instruction &inst = At(seq);
+    const size_t station = StationFile::Index(inst.station_);
+    if (inst.write_time_ != -1) { // waits to commit
+      if (seq == window_.front())
+        return 0;
+    } else if (inst.exec_end_time_ != -1) {
+      // only a store waiting for its data or an older access stays put
+      if (inst.instop_ != InstOp::STORE ||
+          (stations_.Qk_[station] == kNoStation &&
+           (RobMode() || StoreMayWrite(seq))))
+        return 0;
+    } else if (inst.exec_begin_time_ != -1) {
+      const int time = stations_.time_[station];
+      if (time <= 1) // finishes in the next cycle
+        return 0;
+      quiet = std::min<size_t>(quiet, time - 1);
+    } else {
+      if (stations_.Qj_[station] != kNoStation ||
+          stations_.Qk_[station] != kNoStation)
+        continue;
+      // a load held back last cycle waits for an event of an older store
+      if (inst.order_blocked_)
+        continue;
+      if (inst.unit_wait_time_ == -1)
+        return 0;
+      // no unit last cycle, wait for the first to free up
+      const size_t free_at = units_.FreeAt(UnitOf(inst.instop_));
+      if (free_at <= clocks_ + 1)
+        return 0;
+      quiet = std::min(quiet, free_at - clocks_ - 1);
+    }
+  }
+  if (fetch_ < EndSeq() && HasRobEntry() &&
+      FindFreeStation(At(fetch_)) != kNoStation)
+    return 0;
+  return quiet == SIZE_MAX ? 0 : quiet;
+}
+
+CycleKind TomasuloSimulator::HeadStall() const {
+  if (window_.empty())
+    return CycleKind::FRONTEND;
+  const Instruction &head = At(window_.front());
+  const Cycle clocks = static_cast<Cycle>(clocks_);
+  if (head.write_time_ != -1)
+    return CycleKind::COMMIT;
+  if (head.exec_end_time_ != -1 && head.exec_end_time_ < clocks) {
+    return head.instop_ == InstOp::STORE ? CycleKind::STORE_DATA
+                                         : CycleKind::CDB;
+  }
+  if (head.exec_begin_time_ != -1 && head.exec_begin_time_ <= clocks)
+    return CycleKind::EXECUTE;
+  if (head.issue_time_ == clocks)
+    return CycleKind::FRONTEND;
+  if (head.unit_wait_time_ != -1 && head.unit_wait_time_ <= clocks)
+    return CycleKind::STRUCTURAL;
+  return CycleKind::RAW;
+}
+
+void TomasuloSimulator::AccountCycles(size_t cycles) {
+  const CycleKind kind = retired_in_cycle_ ? CycleKind::BASE : HeadStall();
+  account_.run_[static_cast<size_t>(kind)] += cycles;
+  retired_in_cycle_ = false;
+}
+
+void TomasuloSimulator::SkipCycles(size_t cycles) {
+  while (cycles > 0) {
+    size_t chunk = cycles;
+    if (record_history_) { // land on every checkpoint cycle
+      chunk = std::min(chunk,
+                       history_.interval_ - clocks_ % history_.interval_);
+    }
+    clocks_ += chunk;
+    cycles -= chunk;
+    AccountCycles(chunk);
+    for (size_t seq : window_) {
+      const Instruction &inst = At(seq);
+      if (inst.exec_begin_time_ != -1 && inst.exec_end_time_ == -1)
+        stations_.time_[StationFile::Index(inst.station_)] -=
+            static_cast<int>(chunk);
     }
-    std::cout << '\t';
+    if (record_history_)
+      StoreState();
   }
-  std::cout << "\t\n";
 }
 
-void TomasuloSimulator::HelpPrintStatistic(const size_t clocks,
-                                           const int raw_stalls,
-                                           const int war_stalls) {
-  std::cout << "Statistic\n";
-  std::cout << "Total:\n\t" << clocks << " cycle clocks executed\n";
-  std::cout << "Stalls:\n"
-            << "\tRAW stalls: " << raw_stalls << "\n"
-            << "\tWAR stalls: " << war_stalls << "\n"
-            << "\tTotal: " << raw_stalls + war_stalls << "\n";
+void TomasuloSimulator::Advance(size_t cycles) {
+  HostScope other(host_profile_, HostPhase::OTHER);
+  size_t done = 0;
+  while (done < cycles && !IsFinish()) {
+    size_t quiet = event_driven_ ? std::min(QuietCycles(), cycles - done) : 0;
+    if (quiet > 0) {
+      HostScope skip(host_profile_, HostPhase::SKIP);
+      SkipCycles(quiet);
+      done += quiet;
+    } else {
+      SingleStep();
+      ++done;
+    }
+  }
 }
+void TomasuloSimulator::RunToEnd() { Advance(SIZE_MAX); }
+
 std::string InstOpToStr(InstOp instop) {
   std::string ans;
   switch (instop) {
@@ -520,6 +870,15 @@ std::string InstOpToStr(InstOp instop) {
   case InstOp::DIVD:
     ans = "DIV.D";
     break;
+  case InstOp::DADDI:
+    ans = "DADDI";
+    break;
+  case InstOp::BEQ:
+    ans = "BEQ";
+    break;
+  case InstOp::BNE:
+    ans = "BNE";
+    break;
   case InstOp::NONE:
     ans = "NONE";
     break;
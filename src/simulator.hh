@@ -1,8 +1,15 @@
 #pragma once
 
+#include "config.hh"
+#include "history.hh"
+#include "host_profile.hh"
+#include "observer.hh"
+#include "pipeline_trace.hh"
 #include "util.hh"
 #include <cstddef>
+#include <functional>
 #include <memory>
+#include <ostream>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -11,50 +18,147 @@ public:
   size_t clocks_{0};
   size_t raw_stalls_{0};
   size_t war_stalls_{0};
-  size_t num_left_instructions_;
-  const int loadstore_latency_ = 2;
-  const int adddsubd_latency_ = 2;
-  const int multd_latency_ = 10;
-  const int divd_latency_ = 40;
-  std::vector<std::shared_ptr<Instruction>> instructions_;
-  std::vector<std::shared_ptr<Station>> loadstore_stations_;
-  std::vector<std::shared_ptr<Station>> reservation_stations_;
-  std::unordered_map<std::string, std::string> registers_;
-  std::unordered_map<std::string, std::string> memory_;
-  std::unordered_map<std::string, std::shared_ptr<Station>> register_status_;
-  std::vector<SimulatorState> states_;
+  // keep checkpoints for Backtrace()
+  bool record_history_{true};
+  // jump over cycles in which only execution countdowns change
+  bool event_driven_{true};
+  // station counts and latencies
+  MachineConfig config_;
+  // why the run stopped early, e.g. a branch in symbolic mode
+  std::string error_;
+  // run config_ on a core specialized for it when there is one
+  bool specialized_core_{true};
+  // StepCycle() instance for config_, picked on the first step
+  void (TomasuloSimulator::*step_cycle_)() {nullptr};
+  // decodes the program on demand, see Fetch()
+  std::shared_ptr<InstructionSource> source_;
+  ControlFlow control_;
+  CycleAccount account_;
+  // caches and store-to-load forwarding
+  MemoryTiming memory_timing_;
+  // shared by the stations when config_ limits them
+  FunctionalUnits units_;
+  // something retired in the cycle being simulated
+  bool retired_in_cycle_{false};
+  // fetched instructions, the first one is number first_seq_
+  InstructionQueue instructions_;
+  size_t first_seq_{0};
+  // keep the fetched instructions for display and Backtrace(); when off,
+  // the written back ones are dropped and in numeric mode memory stays
+  // bounded by the instructions in flight, however long the trace.
+  // Symbolic runs still grow arena_ and memory_ with every result.
+  bool retain_instructions_{true};
+  // even when on, only this many of the written back ones are kept, the
+  // latest, so a numeric loop can run on forever in bounded memory
+  size_t max_retained_{1 << 16};
+  // issued but not yet written back, in program order; every cycle only
+  // walks these, so its cost is bounded by the number of stations
+  std::vector<size_t> window_;
+  // next instruction to issue
+  size_t fetch_{0};
+  // called with every instruction as it writes back
+  std::function<void(size_t seq, const Instruction &inst)> retire_sink_;
+  // gets every instruction as it retires, none if null
+  std::shared_ptr<PipelineTrace> pipeline_trace_;
+  // told of every pipeline event, none if null; not owned
+  SimulatorObserver *observer_{nullptr};
+  // where the host time of the run goes, when started
+  HostProfile host_profile_;
+  StationFile stations_;
+  // symbolic values in registers_, memory_ and the stations live here
+  std::shared_ptr<ExprArena> arena_{std::make_shared<ExprArena>()};
+  RegisterFile registers_;
+  Memory memory_;
+  // real values instead of symbolic ones, see EnableNumericMode()
+  bool numeric_{false};
+  MemoryImage memory_image_;
+  RegisterStatus register_status_;
+  History history_;
 
   TomasuloSimulator() = delete;
-  TomasuloSimulator(std::vector<std::shared_ptr<Instruction>> &&instructions,
-                    const int num_load_stations = 3,
-                    const int num_add_rsstation = 3,
-                    const int num_mul_rsstation = 2);
+  explicit TomasuloSimulator(std::shared_ptr<InstructionSource> source,
+                             const MachineConfig &config = MachineConfig());
+  // resume from a snapshot taken by Snapshot()
+  explicit TomasuloSimulator(const SimulatorState &state);
   bool IsFinish() const;
-  void PrintInstructions() const;
-  void PrintLoadAndReservStations() const;
-  void PrintRegisterStatus() const;
-  void PrintStatistic() const;
-  void PrintAllInfo() const;
+  Instruction &At(size_t seq) { return instructions_[seq - first_seq_]; }
+  const Instruction &At(size_t seq) const {
+    return instructions_[seq - first_seq_];
+  }
+  // sequence number one past the last fetched instruction
+  size_t EndSeq() const { return first_seq_ + instructions_.size(); }
+  // Decode the program up front, up to the first branch, so every
+  // instruction is listed from the first cycle. Return false and fill error
+  // on a malformed line.
+  bool LoadAll(std::string &error);
+  // decode the instruction at control_.pc_, false if there is none
+  bool FetchNext();
+  // keep the next instruction to issue decoded
+  void Fetch();
+  // fetch from pc instead of the start of the program, before the first
+  // step; registers and memory are left as they are
+  void StartAt(size_t pc);
+  bool RobMode() const { return config_.rob_entries_ > 0; }
+  bool HasRobEntry() const;
+  // Check a load at address against the older stores not yet in memory.
+  // Return false if it must wait: one of them has no address yet, or the
+  // youngest one to the same address no data. Otherwise forward is that
+  // store, or SIZE_MAX to read memory.
+  bool OrderLoad(size_t seq, const Value &address, size_t &forward) const;
+  // without a reorder buffer a store writes memory on writeback, once no
+  // older access may touch its address
+  bool StoreMayWrite(size_t seq) const;
+  // number of the memory word or the symbolic expression at address
+  uint64_t AddressKey(const Value &address) const;
+  // Update the predictor with a resolved branch and redirect fetch. Return
+  // true on a misprediction, the younger instructions are then Squash()ed.
+  bool ResolveBranch(const Instruction &inst);
+  void Squash(size_t branch_seq);
+  // retire up to commit_width_ written back instructions, in order
+  void Commit();
 
+  // switch to real values, before the first step
+  void EnableNumericMode(const RegisterImage &registers,
+                         std::shared_ptr<const MappedFile> memory_image);
+  Value MakeImm(int imm);
+  Value Compute(ExprKind kind, const Value &lhs, const Value &rhs);
+  Value ReadMemory(const Value &address);
+  template <class Shape> int Latency(InstOp instop) const;
+  template <class Shape> bool TryIssue(Instruction &inst);
+  // start executing the issued instruction seq, whose operands are ready,
+  // unless it is a load that OrderLoad() holds back or there is no free
+  // functional unit
+  template <class Shape> void BeginExecution(size_t seq);
+  // end of execution: compute the result held by station
+  void FinishExecution(size_t seq, size_t station);
+  void Retire(size_t seq);
+  // value of reg, or the tag of the station that will produce it
+  void ReadOperand(RegId reg, Value &V, StationTag &Q) const;
+  template <class Shape = RuntimeShape>
+  StationTag FindFreeStation(const Instruction &inst) const;
+  void WriteMemory(const Value &address, const Value &value);
+  // final registers and the memory written, one per line
+  void DumpArchState(std::ostream &os) const;
+
+  SimulatorState Snapshot() const;
+  void Restore(const SimulatorState &state);
   void StoreState();
-  void Run();
   void SingleStep();
-  void Step(size_t cycles = 1);
+  // One cycle of SingleStep(); Shape fixes the station counts and latencies
+  // at compile time, or is RuntimeShape to read them from config_.
+  template <class Shape> void StepCycle();
+  void SelectCore();
+  // Number of coming cycles in which nothing happens but executing
+  // instructions counting down, 0 if the next cycle has an event.
+  size_t QuietCycles() const;
+  // what holds up the oldest instruction in flight in this cycle
+  CycleKind HeadStall() const;
+  // add cycles cycles alike to the CPI stack of the run
+  void AccountCycles(size_t cycles);
+  void SkipCycles(size_t cycles);
+  // up to cycles cycles, skipping quiet ones when event_driven_
+  void Advance(size_t cycles);
   void RunToEnd();
-  void Backtrace(size_t cycles = 1);
 
-  static void HelpPrintUsage();
-  static void HelpPrintInstructions(
-      const std::vector<std::shared_ptr<Instruction>> &instructions,
-      const size_t clocks);
-  static void HelpPrintLoadAndReservStations(
-      const std::vector<std::shared_ptr<Station>> &loadstore_stations,
-      const std::vector<std::shared_ptr<Station>> &reservation_stations);
-  static void HelpPrintRegisterStatus(
-      const std::unordered_map<std::string, std::shared_ptr<Station>>
-          &register_status);
-  static void HelpPrintStatistic(const size_t clocks, const int raw_stalls,
-                                 const int war_stalls);
-  static void
-  HelpPrintReservStation(const std::shared_ptr<Station> &reserv_station);
+  static bool CanIssueTo(const Instruction &inst, StationType station_type);
 };
\ No newline at end of file
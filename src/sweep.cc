@@ -0,0 +1,148 @@
+#include "sweep.hh"
+#include "batch.hh"
+#include "config.hh"
+#include "options.hh"
+#include "pool.hh"
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool ParseInt(const std::string &text, long &value) {
+  char *end = nullptr;
+  value = std::strtol(text.c_str(), &end, 10);
+  return !text.empty() && *end == '\0' && value >= INT_MIN && value <= INT_MAX;
+}
+
+// One comma-separated item of an axis: a value or lo:hi[:step]. The
+// endpoints are checked against the range of key and the points counted
+// before a range is expanded.
+bool ParseAxisItem(const std::string &key, const std::string &item,
+                   std::vector<int> &values, std::string &error) {
+  std::vector<long> parts;
+  std::istringstream iss(item);
+  std::string part;
+  while (std::getline(iss, part, ':')) {
+    long value;
+    if (!ParseInt(part, value)) {
+      parts.clear();
+      break;
+    }
+    parts.push_back(value);
+  }
+  if (parts.empty() || parts.size() > 3 ||
+      (parts.size() > 1 && parts[0] > parts[1]) ||
+      (parts.size() == 3 && parts[2] <= 0)) {
+    error = "Invalid value \"" + item + "\" of " + key;
+    return false;
+  }
+  const long lo = parts[0];
+  const long hi = parts.size() > 1 ? parts[1] : lo;
+  const long step = parts.size() == 3 ? parts[2] : 1;
+  MachineConfig scratch;
+  if (!scratch.Set(key, static_cast<int>(lo), error) ||
+      !scratch.Set(key, static_cast<int>(hi), error))
+    return false;
+  const size_t count = static_cast<size_t>((hi - lo) / step) + 1;
+  if (values.size() + count > kMaxSweepValues) {
+    error = key + " takes more than " + std::to_string(kMaxSweepValues) +
+            " values";
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    values.push_back(static_cast<int>(lo + static_cast<long>(i) * step));
+  }
+  return true;
+}
+
+} // namespace
+
+bool SweepGrid::AddAxis(const std::string &spec, std::string &error) {
+  size_t eq = spec.find('=');
+  if (eq == std::string::npos) {
+    error = "Expected key=values instead of \"" + spec + "\"";
+    return false;
+  }
+  std::string key = spec.substr(0, eq);
+  std::vector<int> values;
+  std::istringstream iss(spec.substr(eq + 1));
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (!ParseAxisItem(key, item, values, error))
+      return false;
+  }
+  if (values.empty()) {
+    error = "No values for " + key;
+    return false;
+  }
+  size_t points = values.size();
+  for (const auto &axis : axes_) {
+    points *= axis.second.size();
+    if (points > kMaxSweepPoints)
+      break;
+  }
+  if (points > kMaxSweepPoints) {
+    error = "The grid has more than " + std::to_string(kMaxSweepPoints) +
+            " points with " + key;
+    return false;
+  }
+  axes_.emplace_back(key, std::move(values));
+  return true;
+}
+
+std::vector<MachineConfig>
+SweepGrid::Expand(const MachineConfig &base) const {
+  std::vector<MachineConfig> configs{base};
+  for (const auto &[key, values] : axes_) {
+    std::vector<MachineConfig> expanded;
+    expanded.reserve(configs.size() * values.size());
+    for (const auto &config : configs) {
+      for (int value : values) {
+        MachineConfig point = config;
+        std::string error; // values were checked by AddAxis()
+        point.Set(key, value, error);
+        expanded.push_back(point);
+      }
+    }
+    configs = std::move(expanded);
+  }
+  return configs;
+}
+
+size_t RunSweep(const std::vector<std::string> &paths,
+                const std::vector<MachineConfig> &configs, size_t num_threads,
+                const SimulationOptions &options, std::ostream &os) {
+  std::vector<std::string> rows(configs.size() * paths.size());
+  std::vector<char> failed(rows.size(), 0);
+  ParallelFor(rows.size(), num_threads, [&](size_t i) {
+    const MachineConfig &config = configs[i / paths.size()];
+    SimulationOptions point_options = options;
+    point_options.config_ = config;
+    BatchResult result =
+        SimulateTrace(paths[i % paths.size()], point_options, false);
+    std::ostringstream oss;
+    config.Print(oss);
+    oss << '\t';
+    result.Print(oss, true);
+    failed[i] = !result.ok_;
+    rows[i] = oss.str();
+  });
+  size_t num_failed = 0;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    os << rows[i] << '\n';
+    num_failed += failed[i];
+  }
+  return num_failed;
+}
+
+void HelpPrintSweepHeader(std::ostream &os) {
+  MachineConfig::HelpPrintHeader(os);
+  os << '\t';
+  BatchResult::HelpPrintHeader(os, true);
+  os << '\n';
+}
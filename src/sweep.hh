@@ -0,0 +1,36 @@
+#pragma once
+
+#include "config.hh"
+#include "options.hh"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// limits of an axis and of the whole grid, checked as axes are added
+constexpr size_t kMaxSweepValues = 4096;
+constexpr size_t kMaxSweepPoints = 1 << 20;
+
+// Machine configurations to explore, the cartesian product of the axes
+class SweepGrid {
+public:
+  // a parameter of MachineConfig and the values it takes
+  std::vector<std::pair<std::string, std::vector<int>>> axes_;
+
+  // Add "key=v1,v2,..." where a value may also be a range lo:hi[:step].
+  // Return false and fill error if the spec is invalid, a value is out of
+  // the range of key, or there would be too many points.
+  bool AddAxis(const std::string &spec, std::string &error);
+  // every point of the grid on top of base, the last axis varying fastest
+  std::vector<MachineConfig> Expand(const MachineConfig &base) const;
+};
+
+// Simulate every trace under every configuration on a pool of num_threads
+// workers and write one row per pair to os, configuration by configuration.
+// Return the number of failed simulations.
+size_t RunSweep(const std::vector<std::string> &paths,
+                const std::vector<MachineConfig> &configs, size_t num_threads,
+                const SimulationOptions &options, std::ostream &os);
+
+void HelpPrintSweepHeader(std::ostream &os);
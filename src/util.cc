@@ -1,56 +1,343 @@
 #include "util.hh"
 #include "simulator.hh"
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <type_traits>
 #include <utility>
 
-Station::Station(std::string name, StationType station_type)
-    : name_(name), station_type_(station_type), instop_(InstOp::NONE),
-      busy_(false), time_(-1), Qj_(nullptr), Qk_(nullptr) {}
+RegId RegFromName(std::string_view name) {
+  if (name.size() < 2 || name.size() > 3 || (name[0] != 'F' && name[0] != 'R'))
+    return kNoReg;
+  int index = 0;
+  for (size_t i = 1; i < name.size(); ++i) {
+    if (name[i] < '0' || name[i] > '9')
+      return kNoReg;
+    index = index * 10 + (name[i] - '0');
+  }
+  if (index >= kNumFpRegisters || (name.size() == 3 && name[1] == '0'))
+    return kNoReg;
+  return static_cast<RegId>(name[0] == 'F' ? index : kNumFpRegisters + index);
+}
+
+std::string RegName(RegId reg) {
+  if (reg < kNumFpRegisters)
+    return "F" + std::to_string(reg);
+  return "R" + std::to_string(reg - kNumFpRegisters);
+}
+
+bool LoadRegisterImage(const std::string &path, RegisterImage &registers,
+                       std::string &error) {
+  std::ifstream fin(path);
+  if (!fin) {
+    error = "Cannot open " + path;
+    return false;
+  }
+  registers.fill(0.0);
+  std::string line;
+  while (std::getline(fin, line)) {
+    std::istringstream iss(line);
+    std::string name;
+    double value;
+    if (!(iss >> name))
+      continue;
+    RegId reg = RegFromName(name);
+    if (reg == kNoReg || !(iss >> value)) {
+      error = "Invalid register image line \"" + line + "\"";
+      return false;
+    }
+    registers[reg] = value;
+  }
+  return true;
+}
+
+StationFile::StationFile(int num_load_stations, int num_add_rsstation,
+                         int num_mul_rsstation) {
+  for (int i = 1; i <= num_load_stations; ++i) {
+    AddStation("Load" + std::to_string(i), StationType::LOAD);
+  }
+  num_load_stations_ = Size();
+  for (int i = 1; i <= num_add_rsstation; ++i) {
+    AddStation("Add" + std::to_string(i), StationType::ADD);
+  }
+  for (int i = 1; i <= num_mul_rsstation; ++i) {
+    AddStation("Mult" + std::to_string(i), StationType::MULT);
+  }
+  hits_.assign((Size() + 7) / 8 * 8, 0);
+}
+
+void StationFile::AddStation(std::string name, StationType station_type) {
+  name_.push_back(std::move(name));
+  station_type_.push_back(station_type);
+  instop_.push_back(InstOp::NONE);
+  busy_.push_back(false);
+  time_.push_back(-1);
+  Vj_.emplace_back();
+  Vk_.emplace_back();
+  Qj_.push_back(kNoStation);
+  Qk_.push_back(kNoStation);
+  Address_.emplace_back();
+  waited_on_.push_back(InstOp::NONE);
+}
+
+void StationFile::ResetEmpty(size_t index) {
+  instop_[index] = InstOp::NONE;
+  busy_[index] = false;
+  time_[index] = -1;
+  Vj_[index] = Value();
+  Vk_[index] = Value();
+  Qj_[index] = kNoStation;
+  Qk_[index] = kNoStation;
+  Address_[index] = Value();
+  waited_on_[index] = InstOp::NONE;
+}
 
-void Station::ResetEmpty() {
-  instop_ = InstOp::NONE;
-  busy_ = false;
-  time_ = -1;
-  Vj_.clear();
-  Vk_.clear();
-  Qj_ = nullptr;
-  Qk_ = nullptr;
-  Address_.clear();
+UnitType UnitOf(InstOp instop) {
+  switch (instop) {
+  case InstOp::LOAD:
+  case InstOp::STORE:
+    return UnitType::LOAD;
+  case InstOp::ADDD:
+  case InstOp::SUBD:
+    return UnitType::ADD;
+  case InstOp::MULD:
+    return UnitType::MULT;
+  case InstOp::DIVD:
+    return UnitType::DIV;
+  case InstOp::DADDI:
+  case InstOp::BEQ:
+  case InstOp::BNE:
+    return UnitType::INT;
+  case InstOp::NONE:
+    break;
+  }
+  return UnitType::NONE;
 }
 
-std::shared_ptr<Station> Station::Clone() const {
-  return std::make_shared<Station>(*this);
+FunctionalUnits::FunctionalUnits(const MachineConfig &config) {
+  const int counts[kNumUnitTypes] = {
+      config.num_load_units_, config.num_add_units_, config.num_mult_units_,
+      config.num_div_units_, config.num_int_units_};
+  interval_ = {config.load_interval_, config.add_interval_,
+               config.mult_interval_, config.div_interval_,
+               config.int_interval_};
+  for (size_t type = 0; type < kNumUnitTypes; ++type) {
+    free_at_[type].assign(counts[type], 0);
+  }
 }
 
-Instruction::Instruction(InstOp instop, std::string text, std::string rd_or_imm,
-                         std::string rs, std::string rt)
-    : instop_(instop), text_(std::move(text)), rd_or_imm_(rd_or_imm), rs_(rs),
-      rt_(rt), issue_time_(-1), exec_begin_time_(-1), exec_end_time_(-1),
-      write_time_(-1), station_(nullptr) {}
+size_t FunctionalUnits::FreeAt(UnitType type) const {
+  const auto &free_at = free_at_[Index(type)];
+  return *std::min_element(free_at.begin(), free_at.end());
+}
+
+bool FunctionalUnits::Claim(UnitType type, size_t begin) {
+  auto &free_at = free_at_[Index(type)];
+  auto unit = std::min_element(free_at.begin(), free_at.end());
+  if (*unit > begin)
+    return false;
+  *unit = begin + interval_[Index(type)];
+  return true;
+}
+
+BranchPredictor::BranchPredictor(size_t num_entries)
+    : counters_(num_entries, 1) {}
+
+bool BranchPredictor::Predict(size_t pc) const {
+  return counters_[pc % counters_.size()] >= 2;
+}
+
+void BranchPredictor::Update(size_t pc, bool taken) {
+  uint8_t &counter = counters_[pc % counters_.size()];
+  if (taken && counter < 3)
+    ++counter;
+  else if (!taken && counter > 0)
+    --counter;
+}
+
+Instruction::Instruction(InstOp instop, std::string_view text, RegId rd,
+                         RegId rs, RegId rt, int imm)
+    : instop_(instop), text_(text), rd_(rd), rs_(rs), rt_(rt), imm_(imm) {}
+
+static_assert(std::is_trivially_copyable_v<Instruction>,
+              "InstructionQueue copies instructions as raw memory");
 
-std::shared_ptr<Instruction> Instruction::Clone() const {
-  return std::make_shared<Instruction>(*this);
+InstructionQueue &InstructionQueue::operator=(const InstructionQueue &other) {
+  if (this == &other)
+    return *this;
+  if (slots_.size() < other.size_) {
+    size_t capacity = 16;
+    while (capacity < other.size_)
+      capacity *= 2;
+    slots_ = std::vector<Instruction>(capacity);
+  }
+  other.CopyTo(slots_.data());
+  head_ = 0;
+  size_ = other.size_;
+  return *this;
+}
+
+InstructionQueue &
+InstructionQueue::operator=(InstructionQueue &&other) noexcept {
+  slots_ = std::move(other.slots_);
+  head_ = std::exchange(other.head_, 0);
+  size_ = std::exchange(other.size_, 0);
+  other.slots_.clear();
+  return *this;
+}
+
+void InstructionQueue::resize(size_t size) {
+  if (size > slots_.size())
+    Grow(size);
+  for (size_t i = size_; i < size; ++i) {
+    (*this)[i] = Instruction();
+  }
+  size_ = size;
+}
+
+void InstructionQueue::Grow(size_t size) {
+  size_t capacity = slots_.empty() ? 16 : slots_.size();
+  while (capacity < size)
+    capacity *= 2;
+  std::vector<Instruction> slots(capacity);
+  CopyTo(slots.data());
+  slots_ = std::move(slots);
+  head_ = 0;
+}
+
+void InstructionQueue::CopyTo(Instruction *to) const {
+  if (size_ == 0)
+    return;
+  // at most two runs: from head_ to the end of the slots, then from 0
+  const size_t first = std::min(size_, slots_.size() - head_);
+  std::memcpy(static_cast<void *>(to), &slots_[head_],
+              first * sizeof(Instruction));
+  std::memcpy(static_cast<void *>(to + first), slots_.data(),
+              (size_ - first) * sizeof(Instruction));
+}
+
+const char *CycleKindName(CycleKind kind) {
+  switch (kind) {
+  case CycleKind::BASE:
+    return "base";
+  case CycleKind::STRUCTURAL:
+    return "structural";
+  case CycleKind::RAW:
+    return "raw";
+  case CycleKind::EXECUTE:
+    return "execute";
+  case CycleKind::CDB:
+    return "cdb";
+  case CycleKind::STORE_DATA:
+    return "store_data";
+  case CycleKind::COMMIT:
+    return "commit";
+  case CycleKind::FRONTEND:
+    return "frontend";
+  case CycleKind::NONE:
+    break;
+  }
+  return "";
+}
+
+CycleStack InstructionCycles(const Instruction &inst) {
+  auto span = [](Cycle from, Cycle to) {
+    return from < to ? static_cast<size_t>(to - from) : 0;
+  };
+  CycleStack cycles{};
+  auto at = [&cycles](CycleKind kind) -> size_t & {
+    return cycles[static_cast<size_t>(kind)];
+  };
+  at(CycleKind::BASE) = inst.commit_time_ != -1 ? 3 : 2;
+  if (inst.ready_time_ != -1)
+    at(CycleKind::STRUCTURAL) = span(inst.ready_time_, inst.issue_time_);
+  // ready, then waiting for a functional unit
+  const Cycle ready = inst.unit_wait_time_ != -1 ? inst.unit_wait_time_
+                                                 : inst.exec_begin_time_;
+  at(CycleKind::RAW) = span(inst.issue_time_ + 1, ready);
+  at(CycleKind::STRUCTURAL) += span(ready, inst.exec_begin_time_);
+  at(CycleKind::EXECUTE) = span(inst.exec_begin_time_, inst.exec_end_time_ + 1);
+  at(inst.instop_ == InstOp::STORE ? CycleKind::STORE_DATA : CycleKind::CDB) =
+      span(inst.exec_end_time_ + 1, inst.write_time_);
+  if (inst.commit_time_ != -1)
+    at(CycleKind::COMMIT) = span(inst.write_time_ + 1, inst.commit_time_);
+  return cycles;
+}
+
+size_t CycleAccount::AddRetired(const Instruction &inst) {
+  const size_t op = static_cast<size_t>(inst.instop_);
+  const CycleStack cycles = InstructionCycles(inst);
+  for (size_t kind = 0; kind < kNumCycleKinds; ++kind) {
+    by_op_[op][kind] += cycles[kind];
+  }
+  ++retired_by_op_[op];
+  const size_t raw = cycles[static_cast<size_t>(CycleKind::RAW)];
+  if (raw != 0) {
+    // no producer: a load kept behind an older store
+    const InstOp producer = inst.raw_producer_ == InstOp::NONE
+                                ? InstOp::STORE
+                                : inst.raw_producer_;
+    raw_by_producer_[static_cast<size_t>(producer)] += raw;
+  }
+  return raw;
+}
+
+size_t CycleAccount::Retired() const {
+  size_t retired = 0;
+  for (size_t count : retired_by_op_) {
+    retired += count;
+  }
+  return retired;
+}
+
+std::string CycleAccount::RunStackString() const {
+  std::string text;
+  for (size_t kind = 0; kind < kNumCycleKinds; ++kind) {
+    if (kind != 0)
+      text += ',';
+    text += CycleKindName(static_cast<CycleKind>(kind));
+    text += '=' + std::to_string(run_[kind]);
+  }
+  return text;
 }
 
 SimulatorState::SimulatorState(
     size_t clocks, size_t raw_stalls, size_t war_stalls,
-    size_t num_left_instructions,
-    std::vector<std::shared_ptr<Instruction>> instructions,
-    std::vector<std::shared_ptr<Station>> loadstore_stations,
-    std::vector<std::shared_ptr<Station>> reservation_stations,
-    std::unordered_map<std::string, std::string> registers,
-    std::unordered_map<std::string, std::string> memory,
-    std::unordered_map<std::string, std::shared_ptr<Station>> register_status)
+    const MachineConfig &config, std::shared_ptr<InstructionSource> source,
+    InstructionQueue instructions, size_t first_seq,
+    std::vector<size_t> window, size_t fetch, ControlFlow control,
+    CycleAccount account, MemoryTiming memory_timing, FunctionalUnits units,
+    StationFile stations, RegisterFile registers, Memory memory,
+    RegisterStatus register_status,
+    std::shared_ptr<ExprArena> arena, bool numeric, MemoryImage memory_image)
     : clocks_(clocks), raw_stalls_(raw_stalls), war_stalls_(war_stalls),
-      num_left_instructions_(num_left_instructions),
-      instructions_(instructions), loadstore_stations_(loadstore_stations),
-      reservation_stations_(reservation_stations), registers_(registers),
-      memory_(memory), register_status_(register_status) {}
-
-void SimulatorState::PrintAllInfo() const {
-  TomasuloSimulator::HelpPrintInstructions(instructions_, clocks_);
-  TomasuloSimulator::HelpPrintLoadAndReservStations(loadstore_stations_,
-                                                    reservation_stations_);
-  TomasuloSimulator::HelpPrintRegisterStatus(register_status_);
-  TomasuloSimulator::HelpPrintStatistic(clocks_, raw_stalls_, war_stalls_);
-}
\ No newline at end of file
+      config_(config), source_(std::move(source)),
+      instructions_(std::move(instructions)),
+      first_seq_(first_seq), window_(std::move(window)), fetch_(fetch),
+      control_(std::move(control)), account_(account),
+      memory_timing_(std::move(memory_timing)), units_(std::move(units)),
+      stations_(std::move(stations)),
+      registers_(std::move(registers)), memory_(std::move(memory)),
+      register_status_(std::move(register_status)), arena_(std::move(arena)),
+      numeric_(numeric), memory_image_(std::move(memory_image)) {}
+
+size_t SimulatorState::ApproxBytes() const {
+  size_t bytes = sizeof(SimulatorState) + window_.size() * sizeof(size_t);
+  bytes += instructions_.Capacity() * sizeof(Instruction) +
+           control_.predictor_.counters_.size() +
+           memory_timing_.ApproxBytes();
+  for (const auto &free_at : units_.free_at_) {
+    bytes += free_at.size() * sizeof(size_t);
+  }
+  for (const auto &name : stations_.name_) {
+    bytes += sizeof(std::string) + name.capacity() + sizeof(StationType) +
+             2 * sizeof(InstOp) + sizeof(uint8_t) + sizeof(int) +
+             3 * sizeof(Value) + 2 * sizeof(StationTag);
+  }
+  bytes += memory_.ApproxBytes() + memory_image_.stores_.ApproxBytes();
+  return bytes;
+}
@@ -1,9 +1,18 @@
 #pragma once
 
+#include "cache.hh"
+#include "config.hh"
+#include "expr.hh"
+#include "flat_map.hh"
+#include "memory.hh"
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 // Instruction Type
@@ -14,8 +23,31 @@ enum class InstOp {
   SUBD,
   MULD,
   DIVD,
+  DADDI, // integer add immediate
+  BEQ,
+  BNE,
   NONE,
 };
+constexpr size_t kNumInstOps = static_cast<size_t>(InstOp::NONE);
+
+inline bool IsBranch(InstOp instop) {
+  return instop == InstOp::BEQ || instop == InstOp::BNE;
+}
+
+// Register id, decoded at parse time: F0-F31 are 0-31, R0-R31 are 32-63
+using RegId = uint8_t;
+constexpr int kNumFpRegisters = 32;
+constexpr int kNumRegisters = 64;
+constexpr RegId kNoReg = 0xff;
+// kNoReg if name is not a register
+RegId RegFromName(std::string_view name);
+std::string RegName(RegId reg);
+
+// Initial register values of numeric runs
+using RegisterImage = std::array<double, kNumRegisters>;
+// Read "<register> <value>" lines, registers not listed are 0.
+bool LoadRegisterImage(const std::string &path, RegisterImage &registers,
+                       std::string &error);
 
 // Station Type, Add/Mult(ReservationStation), Load(LoadStoreStation)
 enum class StationType {
@@ -24,73 +56,355 @@ enum class StationType {
   MULT,
 };
 
-// Station, include
-// ReservationStation, for add, sub, mult, div
+// Functional unit types, one per latency of MachineConfig
+enum class UnitType {
+  LOAD, // loads and stores
+  ADD,  // ADD.D, SUB.D
+  MULT,
+  DIV,
+  INT, // DADDI and branches
+  NONE,
+};
+constexpr size_t kNumUnitTypes = static_cast<size_t>(UnitType::NONE);
+UnitType UnitOf(InstOp instop);
+
+// The functional units the stations dispatch to, for the types that have a
+// limited number of them
+class FunctionalUnits {
+public:
+  // per type, the cycle from which each unit takes a new operation; empty
+  // when every station has a unit of its own
+  std::array<std::vector<size_t>, kNumUnitTypes> free_at_;
+  std::array<int, kNumUnitTypes> interval_{};
+
+  FunctionalUnits() = default;
+  explicit FunctionalUnits(const MachineConfig &config);
+  bool Limited(UnitType type) const { return !free_at_[Index(type)].empty(); }
+  // first cycle a unit of type takes a new operation
+  size_t FreeAt(UnitType type) const;
+  // Take a unit of type for an operation starting in cycle begin, false if
+  // none is free then.
+  bool Claim(UnitType type, size_t begin);
+
+private:
+  static size_t Index(UnitType type) { return static_cast<size_t>(type); }
+};
+
+// Station tag: index in the StationFile plus one, so that kNoStation can mark
+// a ready operand or a register that waits for no station
+using StationTag = uint16_t;
+constexpr StationTag kNoStation = 0;
+
+// All stations, structure-of-arrays, load stations first:
 // LoadStation, for load, store
-class Station {
+// ReservationStation, for add, sub, mult, div
+// Qj_ and Qk_ of every station are contiguous, so that a CDB broadcast is one
+// vectorizable compare over all tags rather than a walk over the stations.
+class StationFile {
 public:
-  std::string name_;
-  StationType station_type_;
-  InstOp instop_;
-  bool busy_;
-  int time_;
-  std::string Vj_;
-  std::string Vk_;
-  std::shared_ptr<Station> Qj_{nullptr};
-  std::shared_ptr<Station> Qk_{nullptr};
-  std::string Address_;
-  Station() = delete;
-  Station(std::string name, StationType station_type);
-  ~Station() = default;
-  void ResetEmpty();
-
-  std::shared_ptr<Station> Clone() const;
+  size_t num_load_stations_{0};
+  std::vector<std::string> name_;
+  std::vector<StationType> station_type_;
+  std::vector<InstOp> instop_;
+  std::vector<uint8_t> busy_;
+  std::vector<int> time_;
+  std::vector<Value> Vj_;
+  std::vector<Value> Vk_;
+  std::vector<StationTag> Qj_;
+  std::vector<StationTag> Qk_;
+  std::vector<Value> Address_;
+  // producer of the operand received last, for the RAW accounting
+  std::vector<InstOp> waited_on_;
+
+  StationFile() = default;
+  StationFile(int num_load_stations, int num_add_rsstation,
+              int num_mul_rsstation);
+  size_t Size() const { return name_.size(); }
+  static size_t Index(StationTag tag) { return tag - 1; }
+  static StationTag Tag(size_t index) {
+    return static_cast<StationTag>(index + 1);
+  }
+  const std::string &Name(StationTag tag) const { return name_[Index(tag)]; }
+  void ResetEmpty(size_t index);
+  // Hand the result of the station tag, an instruction of type producer, to
+  // every operand waiting for it. kSize is Size() if known at compile time,
+  // then the loops have constant bounds and the match bits live on the stack.
+  template <size_t kSize = 0>
+  void Broadcast(StationTag tag, const Value &result, InstOp producer);
+
+private:
+  void AddStation(std::string name, StationType station_type);
+  // per-station Qj/Qk match bits of Broadcast(), padded to 8 bytes
+  std::vector<uint8_t> hits_;
 };
 
+template <size_t kSize>
+void StationFile::Broadcast(StationTag tag, const Value &result,
+                            InstOp producer) {
+  const size_t size = kSize != 0 ? kSize : Size();
+  // padding stays zero
+  std::array<uint8_t, kSize != 0 ? (kSize + 7) / 8 * 8 : 8> fixed_hits{};
+  uint8_t *hits = kSize != 0 ? fixed_hits.data() : hits_.data();
+  // branch-free, the compiler turns it into SIMD compares of the tags
+  for (size_t i = 0; i < size; ++i) {
+    hits[i] = static_cast<uint8_t>((Qj_[i] == tag) | (Qk_[i] == tag) << 1);
+  }
+  // skip 8 stations at a time, wakeups are rare
+  for (size_t base = 0; base < size; base += 8) {
+    uint64_t word;
+    std::memcpy(&word, &hits[base], sizeof(word));
+    if (word == 0)
+      continue;
+    for (size_t i = base; i < base + 8 && i < size; ++i) {
+      if (hits[i] == 0)
+        continue;
+      if (hits[i] & 1) {
+        Vj_[i] = result;
+        Qj_[i] = kNoStation;
+      }
+      if (hits[i] & 2) {
+        Vk_[i] = result;
+        Qk_[i] = kNoStation;
+      }
+      waited_on_[i] = producer;
+      // a reservation station starts its countdown once both are ready
+      if (station_type_[i] != StationType::LOAD && Qj_[i] == kNoStation &&
+          Qk_[i] == kNoStation) {
+        time_[i] = 0;
+      }
+    }
+  }
+}
+
+// a clock cycle, 64 bits so runs may go on for billions of them
+using Cycle = int64_t;
+
 // Instruction class
+// A compact record: text_ is not copied but views the source line, which the
+// InstructionSource that decoded it keeps alive.
 class Instruction {
 public:
-  InstOp instop_;
-  std::string text_;
-  std::string rd_or_imm_;
-  std::string rs_;
-  std::string rt_;
-  std::string result_;
-  int issue_time_{-1};
-  int exec_begin_time_{-1};
-  int exec_end_time_{-1};
-  int write_time_{-1};
-  std::shared_ptr<Station> station_{nullptr};
-  Instruction() = delete;
-  Instruction(InstOp instop, std::string text, std::string rd_or_imm,
-              std::string rs, std::string rt);
-  ~Instruction() = default;
-  std::shared_ptr<Instruction> Clone() const;
+  InstOp instop_{InstOp::NONE};
+  std::string_view text_;
+  RegId rd_{kNoReg}; // destination, kNoReg for L.D/S.D and branches
+  RegId rs_{kNoReg}; // first source, base register of L.D/S.D
+  RegId rt_{kNoReg}; // second source, data register of L.D/S.D, none for DADDI
+  int imm_{0};       // offset of L.D/S.D and branches, immediate of DADDI
+  size_t pc_{0};     // index in the program
+  Value result_;     // of a branch: 1 if taken
+  Cycle issue_time_{-1};
+  Cycle exec_begin_time_{-1};
+  Cycle exec_end_time_{-1};
+  Cycle write_time_{-1};
+  Cycle commit_time_{-1}; // with a reorder buffer
+  Cycle ready_time_{-1};  // first cycle it could have issued
+  StationTag station_{kNoStation};
+  bool predicted_taken_{false};
+  InstOp raw_producer_{InstOp::NONE}; // sent the operand it waited for last
+  bool forwarded_{false};     // a load that took the data of an older store
+  bool order_blocked_{false}; // a load last held back by an older store
+  Cycle unit_wait_time_{-1}; // first cycle it was ready but found no unit
+  Instruction() = default;
+  Instruction(InstOp instop, std::string_view text, RegId rd, RegId rs,
+              RegId rt, int imm = 0);
+};
+
+// The fetched instructions, a ring buffer.
+// Slots of the dropped oldest instructions are reused for the newly
+// fetched ones, so once the capacity covers the instructions in flight
+// fetching allocates nothing. A copy takes the instructions in one block,
+// oldest first, with a plain memory copy.
+class InstructionQueue {
+public:
+  class const_iterator {
+  public:
+    const_iterator(const InstructionQueue *queue, size_t index)
+        : queue_(queue), index_(index) {}
+    const Instruction &operator*() const { return (*queue_)[index_]; }
+    const_iterator &operator++() {
+      ++index_;
+      return *this;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return index_ != other.index_;
+    }
+
+  private:
+    const InstructionQueue *queue_;
+    size_t index_;
+  };
+
+  InstructionQueue() = default;
+  InstructionQueue(const InstructionQueue &other) { *this = other; }
+  InstructionQueue(InstructionQueue &&other) noexcept {
+    *this = std::move(other);
+  }
+  // reuses the slots if there are enough
+  InstructionQueue &operator=(const InstructionQueue &other);
+  InstructionQueue &operator=(InstructionQueue &&other) noexcept;
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  Instruction &operator[](size_t index) {
+    return slots_[(head_ + index) & (slots_.size() - 1)];
+  }
+  const Instruction &operator[](size_t index) const {
+    return slots_[(head_ + index) & (slots_.size() - 1)];
+  }
+  Instruction &back() { return (*this)[size_ - 1]; }
+  const Instruction &back() const { return (*this)[size_ - 1]; }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size_); }
+  void push_back(const Instruction &inst) {
+    if (size_ == slots_.size())
+      Grow(size_ + 1);
+    (*this)[size_++] = inst;
+  }
+  void pop_front() {
+    head_ = (head_ + 1) & (slots_.size() - 1);
+    --size_;
+  }
+  // drop the youngest ones, or append empty ones
+  void resize(size_t size);
+  void clear() { size_ = 0; }
+  size_t Capacity() const { return slots_.size(); }
+
+private:
+  // room for at least size, oldest first from slot 0
+  void Grow(size_t size);
+  // the instructions, oldest first
+  void CopyTo(Instruction *to) const;
+
+  std::vector<Instruction> slots_; // a power of two of them, or none
+  size_t head_{0};                 // slot of the oldest
+  size_t size_{0};
+};
+
+// The program, decoded on demand.
+// Fetch mostly walks it in order but branches jump anywhere, so instructions
+// are asked for by pc.
+class InstructionSource {
+public:
+  // empty unless Decode() stopped on a malformed instruction
+  std::string error_;
+
+  virtual ~InstructionSource() = default;
+  // Decode the instruction at pc into inst, false past the end or on an
+  // error.
+  virtual bool Decode(size_t pc, Instruction &inst) = 0;
+};
+
+// Two-bit saturating counters indexed by pc
+class BranchPredictor {
+public:
+  std::vector<uint8_t> counters_; // 0, 1 predict not taken, 2, 3 taken
+
+  explicit BranchPredictor(size_t num_entries = 1024);
+  bool Predict(size_t pc) const;
+  void Update(size_t pc, bool taken);
+};
+
+using RegisterFile = std::array<Value, kNumRegisters>;
+
+// Fetch, prediction and commit state of a program with branches
+class ControlFlow {
+public:
+  size_t pc_{0}; // next instruction to fetch
+  // without a reorder buffer fetch waits for every branch to resolve
+  bool fetch_blocked_{false};
+  BranchPredictor predictor_;
+  // registers as of the last commit, to recover from a misprediction
+  RegisterFile committed_registers_;
+  size_t committed_{0};
+  size_t branches_{0};
+  size_t mispredicts_{0};
+  // cycles from the issue of a mispredicted (or, without a reorder buffer,
+  // any) branch to its resolution
+  size_t branch_penalty_{0};
+  size_t flushed_{0}; // wrong-path instructions squashed
+};
+
+// What a cycle is spent on
+enum class CycleKind {
+  BASE,       // issue, writeback, commit
+  STRUCTURAL, // no free station or reorder buffer entry, or functional unit
+  RAW,        // operands not ready
+  EXECUTE,
+  CDB,        // result ready, waiting for the common data bus
+  STORE_DATA, // store executed, waiting for the value to write
+  COMMIT,     // written back, waiting for the older ones to commit
+  FRONTEND,   // nothing issued yet, fetch waits for a branch or refills
+  NONE,
+};
+constexpr size_t kNumCycleKinds = static_cast<size_t>(CycleKind::NONE);
+using CycleStack = std::array<size_t, kNumCycleKinds>;
+
+const char *CycleKindName(CycleKind kind);
+// every cycle of a retired instruction from becoming the next to issue to
+// its writeback, or commit, by kind
+CycleStack InstructionCycles(const Instruction &inst);
+
+// CPI stacks of a run
+class CycleAccount {
+public:
+  // every cycle of the run: a retiring one counts as BASE, any other one as
+  // what held up the oldest instruction in flight
+  CycleStack run_{};
+  std::array<CycleStack, kNumInstOps> by_op_{};
+  std::array<size_t, kNumInstOps> retired_by_op_{};
+  // RAW cycles of the retired instructions, by the type of the producer
+  std::array<size_t, kNumInstOps> raw_by_producer_{};
+
+  // return the RAW cycles of inst
+  size_t AddRetired(const Instruction &inst);
+  size_t Retired() const;
+  // kind=cycles of run_, ','-joined
+  std::string RunStackString() const;
 };
 
+using RegisterStatus = std::array<StationTag, kNumRegisters>;
+// symbolic address -> value, numeric runs use MemoryImage instead
+using Memory = FlatMap<ExprId, Value>;
+
 class SimulatorState {
 public:
   size_t clocks_;
   size_t raw_stalls_;
   size_t war_stalls_;
-  size_t num_left_instructions_;
-  std::vector<std::shared_ptr<Instruction>> instructions_;
-  std::vector<std::shared_ptr<Station>> loadstore_stations_;
-  std::vector<std::shared_ptr<Station>> reservation_stations_;
-  std::unordered_map<std::string, std::string> registers_;
-  std::unordered_map<std::string, std::string> memory_;
-  std::unordered_map<std::string, std::shared_ptr<Station>> register_status_;
+  MachineConfig config_;
+  // shared with the simulator, to fetch again after a replayed branch
+  std::shared_ptr<InstructionSource> source_;
+  InstructionQueue instructions_;
+  size_t first_seq_;
+  std::vector<size_t> window_;
+  size_t fetch_;
+  ControlFlow control_;
+  CycleAccount account_;
+  MemoryTiming memory_timing_;
+  FunctionalUnits units_;
+  StationFile stations_;
+  RegisterFile registers_;
+  Memory memory_;
+  RegisterStatus register_status_;
+  // shared with the simulator, nodes are never removed
+  std::shared_ptr<ExprArena> arena_;
+  bool numeric_;
+  MemoryImage memory_image_;
 
   SimulatorState() = delete;
   SimulatorState(size_t clocks, size_t raw_stalls, size_t war_stalls,
-                 size_t num_left_instructions,
-                 std::vector<std::shared_ptr<Instruction>> instructions,
-                 std::vector<std::shared_ptr<Station>> loadstore_stations,
-                 std::vector<std::shared_ptr<Station>> reservation_stations,
-                 std::unordered_map<std::string, std::string> registers,
-                 std::unordered_map<std::string, std::string> memory,
-                 std::unordered_map<std::string, std::shared_ptr<Station>>
-                     register_status);
+                 const MachineConfig &config,
+                 std::shared_ptr<InstructionSource> source,
+                 InstructionQueue instructions, size_t first_seq,
+                 std::vector<size_t> window, size_t fetch,
+                 ControlFlow control, CycleAccount account,
+                 MemoryTiming memory_timing, FunctionalUnits units,
+                 StationFile stations,
+                 RegisterFile registers, Memory memory,
+                 RegisterStatus register_status,
+                 std::shared_ptr<ExprArena> arena, bool numeric,
+                 MemoryImage memory_image);
   ~SimulatorState() = default;
-  void PrintAllInfo() const;
+  // rough heap footprint, for the history memory budget
+  size_t ApproxBytes() const;
 };
@@ -0,0 +1,152 @@
+#include "workload.hh"
+#include "config.hh"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+class WorkloadField {
+public:
+  const char *name_;
+  int WorkloadSpec::*member_;
+  int min_;
+  int max_;
+};
+
+const WorkloadField kWorkloadFields[] = {
+    {"length", &WorkloadSpec::length_, 1, 1 << 30},
+    {"seed", &WorkloadSpec::seed_, 0, 1 << 30},
+    {"load", &WorkloadSpec::load_weight_, 0, 1 << 20},
+    {"store", &WorkloadSpec::store_weight_, 0, 1 << 20},
+    {"add", &WorkloadSpec::add_weight_, 0, 1 << 20},
+    {"sub", &WorkloadSpec::sub_weight_, 0, 1 << 20},
+    {"mult", &WorkloadSpec::mult_weight_, 0, 1 << 20},
+    {"div", &WorkloadSpec::div_weight_, 0, 1 << 20},
+    {"int", &WorkloadSpec::int_weight_, 0, 1 << 20},
+    {"dep_distance", &WorkloadSpec::dep_distance_, 0, 1024},
+    {"footprint", &WorkloadSpec::footprint_, 8, 1 << 30},
+};
+
+// the even registers, as in the textbook traces
+constexpr int kNumFpRegs = 16;
+constexpr int kNumIntRegs = 8; // R0 is never written
+constexpr size_t kMaxDistance = 64;
+
+class Generator {
+public:
+  explicit Generator(const WorkloadSpec &spec)
+      : spec_(spec), rng_(static_cast<uint64_t>(spec.seed_)) {}
+
+  int Draw(int bound) { return static_cast<int>(rng_() % bound); }
+
+  // a source register, written dep_distance_ instructions back on average
+  int FpSource() {
+    if (spec_.dep_distance_ == 0 || written_.empty())
+      return Draw(kNumFpRegs) * 2;
+    // geometric, its mean is dep_distance_
+    size_t distance = 1;
+    while (distance < kMaxDistance && distance < written_.size() &&
+           Draw(spec_.dep_distance_) != 0) {
+      ++distance;
+    }
+    return written_[(next_ + kMaxDistance - distance) % kMaxDistance];
+  }
+
+  int FpDest() {
+    const int reg = Draw(kNumFpRegs) * 2;
+    if (written_.size() < kMaxDistance) {
+      written_.push_back(reg);
+    } else {
+      written_[next_] = reg;
+    }
+    next_ = (next_ + 1) % kMaxDistance;
+    return reg;
+  }
+
+  int Offset() { return Draw(spec_.footprint_ / 8) * 8; }
+
+private:
+  const WorkloadSpec &spec_;
+  std::mt19937_64 rng_;
+  // destinations of the last kMaxDistance register writes, a ring
+  std::vector<int> written_;
+  size_t next_{0};
+};
+
+} // namespace
+
+bool WorkloadSpec::Set(const std::string &key, int value, std::string &error) {
+  for (const auto &field : kWorkloadFields) {
+    if (key != field.name_)
+      continue;
+    if (value < field.min_ || value > field.max_) {
+      error = key + " must be between " + std::to_string(field.min_) +
+              " and " + std::to_string(field.max_);
+      return false;
+    }
+    this->*field.member_ = value;
+    return true;
+  }
+  error = "Unknown workload parameter " + key;
+  return false;
+}
+
+bool WorkloadSpec::Parse(const std::string &spec, std::string &error) {
+  return ParseKeyValues(
+      spec,
+      [this](const std::string &key, int value, std::string &error) {
+        return Set(key, value, error);
+      },
+      error);
+}
+
+bool GenerateWorkload(const WorkloadSpec &spec, std::ostream &os,
+                      std::string &error) {
+  const std::array<int, 7> weights = {
+      spec.load_weight_, spec.store_weight_, spec.add_weight_,
+      spec.sub_weight_,  spec.mult_weight_,  spec.div_weight_,
+      spec.int_weight_};
+  int total = 0;
+  for (int weight : weights) {
+    total += weight;
+  }
+  if (total == 0) {
+    error = "The workload has no instruction types";
+    return false;
+  }
+  static const char *const kFpOps[] = {"ADD.D", "SUB.D", "MUL.D", "DIV.D"};
+  Generator gen(spec);
+  for (int i = 0; i < spec.length_; ++i) {
+    int pick = gen.Draw(total);
+    size_t type = 0;
+    while (pick >= weights[type]) {
+      pick -= weights[type++];
+    }
+    switch (type) {
+    case 0: {
+      const int offset = gen.Offset();
+      os << "L.D F" << gen.FpDest() << ' ' << offset << " R0\n";
+    } break;
+    case 1: {
+      const int data = gen.FpSource();
+      os << "S.D F" << data << ' ' << gen.Offset() << " R0\n";
+    } break;
+    case 6:
+      os << "DADDI R" << 1 + gen.Draw(kNumIntRegs - 1) << " R"
+         << gen.Draw(kNumIntRegs) << ' ' << gen.Draw(64) - 32 << '\n';
+      break;
+    default: {
+      const int rs = gen.FpSource();
+      const int rt = gen.FpSource();
+      os << kFpOps[type - 2] << " F" << gen.FpDest() << " F" << rs << " F"
+         << rt << '\n';
+    } break;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Shape of a synthetic trace, see GenerateWorkload()
+class WorkloadSpec {
+public:
+  int length_{10000}; // instructions
+  int seed_{1};
+  // relative frequency of L.D, S.D, ADD.D, SUB.D, MUL.D, DIV.D, DADDI
+  int load_weight_{20};
+  int store_weight_{10};
+  int add_weight_{25};
+  int sub_weight_{10};
+  int mult_weight_{15};
+  int div_weight_{5};
+  int int_weight_{0};
+  // Mean number of instructions from a floating-point operand back to the
+  // one writing it; 0 reads random registers.
+  int dep_distance_{4};
+  int footprint_{4096}; // bytes the loads and stores touch, from address 0
+
+  // Set the parameter called key: length, seed, load, store, add, sub, mult,
+  // div, int, dep_distance or footprint. Return false and fill error if key
+  // is unknown or value out of range.
+  bool Set(const std::string &key, int value, std::string &error);
+  // "key=value,key=value,..."
+  bool Parse(const std::string &spec, std::string &error);
+};
+
+// Write a straight-line MIPS trace shaped by spec to os, one instruction per
+// line. The same spec gives the same trace everywhere: the random numbers
+// come from std::mt19937_64, whose sequence the standard fixes.
+// Return false and fill error if spec has no instruction type to draw from.
+bool GenerateWorkload(const WorkloadSpec &spec, std::ostream &os,
+                      std::string &error);
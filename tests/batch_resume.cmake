@@ -0,0 +1,69 @@
+# A batch run resumed from a checkpoint ends at the same cycle as one from
+# cycle 0, and reports the instructions retired since, with their timing.
+# cmake -DSIM=<simulator> -DTRACE=<trace> -DWORK=<dir> -P batch_resume.cmake
+
+set(checkpoint ${WORK}/batch_resume.ckpt)
+file(WRITE ${WORK}/batch_resume.cmds "s 10\nw ${checkpoint}\nq\n")
+execute_process(COMMAND ${SIM} ${TRACE}
+                INPUT_FILE ${WORK}/batch_resume.cmds
+                OUTPUT_QUIET ERROR_QUIET)
+if(NOT EXISTS ${checkpoint})
+  message(FATAL_ERROR "no checkpoint was saved")
+endif()
+
+# fields of the row of a batch run, the ';' of the timing become '|'
+function(batch_row out)
+  execute_process(COMMAND ${SIM} -b ${ARGN} ${TRACE} OUTPUT_VARIABLE text)
+  string(REPLACE ";" "|" text "${text}")
+  string(REPLACE "\n" ";" lines "${text}")
+  list(GET lines 1 row)
+  string(REPLACE "\t" ";" row "${row}")
+  set(${out} "${row}" PARENT_SCOPE)
+endfunction()
+
+batch_row(full)
+batch_row(resumed -L ${checkpoint})
+list(GET full 1 full_status)
+list(GET resumed 1 resumed_status)
+if(NOT full_status STREQUAL "ok" OR NOT resumed_status STREQUAL "ok")
+  message(FATAL_ERROR "status ${full_status}, resumed ${resumed_status}")
+endif()
+list(GET full 2 full_cycles)
+list(GET resumed 2 resumed_cycles)
+if(NOT full_cycles EQUAL resumed_cycles)
+  message(FATAL_ERROR "${resumed_cycles} cycles resumed, ${full_cycles} not")
+endif()
+list(GET full 3 full_instructions)
+list(GET resumed 3 resumed_instructions)
+if(resumed_instructions EQUAL 0 OR
+   NOT resumed_instructions LESS full_instructions)
+  message(FATAL_ERROR "${resumed_instructions} instructions resumed, "
+                      "${full_instructions} not")
+endif()
+
+# the resumed timing rows are those of the same instructions in the full run
+list(GET full 10 full_timing)
+list(GET resumed 10 resumed_timing)
+string(REPLACE "|" ";" full_timing "${full_timing}")
+string(REPLACE "|" ";" resumed_timing "${resumed_timing}")
+list(LENGTH resumed_timing num_rows)
+if(NOT num_rows EQUAL resumed_instructions)
+  message(FATAL_ERROR "${num_rows} timing rows for ${resumed_instructions} "
+                      "instructions")
+endif()
+set(from 0)
+foreach(times IN LISTS resumed_timing)
+  list(LENGTH full_timing size)
+  set(found FALSE)
+  while(from LESS size)
+    list(GET full_timing ${from} full_times)
+    math(EXPR from "${from} + 1")
+    if(full_times STREQUAL times)
+      set(found TRUE)
+      break()
+    endif()
+  endwhile()
+  if(NOT found)
+    message(FATAL_ERROR "timing ${times} is not in the full run")
+  endif()
+endforeach()
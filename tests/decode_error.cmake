@@ -0,0 +1,34 @@
+# A malformed line past a branch is only decoded when fetch reaches it, and
+# still stops the run with its error, interactive or batch.
+# cmake -DSIM=<simulator> -DWORK=<dir> -P decode_error.cmake
+
+set(trace ${WORK}/decode_error.S)
+file(WRITE ${trace} "DADDI R1 R0 3\nloop: ADD.D F2 F2 F4\nDADDI R1 R1 -1\n"
+                    "BNE R1 R0 loop\nFOO.D F0 F0 F0\n")
+file(WRITE ${WORK}/decode_error.cmds "r\nq\n")
+set(expected "decode_error.S:5:1: Operation FOO.D is not support!")
+
+execute_process(COMMAND ${SIM} -n ${trace}
+                INPUT_FILE ${WORK}/decode_error.cmds
+                RESULT_VARIABLE status
+                OUTPUT_VARIABLE output ERROR_VARIABLE error)
+if(status EQUAL 0)
+  message(FATAL_ERROR "the interactive run exited 0")
+endif()
+string(FIND "${error}" "${expected}" at)
+if(at EQUAL -1)
+  message(FATAL_ERROR "the interactive run did not report the bad line:\n"
+                      "${error}")
+endif()
+string(FIND "${output}" "executed compeletely" at)
+if(NOT at EQUAL -1)
+  message(FATAL_ERROR "the interactive run claims to have finished")
+endif()
+
+execute_process(COMMAND ${SIM} -b -n ${trace} OUTPUT_VARIABLE output)
+string(FIND "${output}" "\terror\t" at)
+string(FIND "${output}" "${expected}" message_at)
+if(at EQUAL -1 OR message_at EQUAL -1)
+  message(FATAL_ERROR "the batch run did not report the bad line:\n"
+                      "${output}")
+endif()